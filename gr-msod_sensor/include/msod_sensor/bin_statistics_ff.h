@@ -23,17 +23,24 @@
 #define INCLUDED_MYBLOCKS_BIN_STATISTICS_FF_H
 
 #include <msod_sensor/api.h>
-#include <gnuradio/sync_decimator.h>
+#include <gnuradio/block.h>
+#include <vector>
 
 namespace gr {
   namespace msod_sensor {
 
     /*!
-     * \brief <+description of block+>
+     * \brief Average or peak of vectors over a measurement interval.
      * \ingroup msod_sensor
      *
+     * One output vector per meas_period input vectors. The statistic is
+     * kept up to date as input arrives, so the block never needs a whole
+     * measurement interval of input buffered to make progress.
+     *
+     * Several detectors can be computed in the same pass over the input,
+     * each on its own output port.
      */
-    class MSOD_SENSOR_API bin_statistics_ff : virtual public gr::sync_decimator
+    class MSOD_SENSOR_API bin_statistics_ff : virtual public gr::block
     {
      public:
       typedef boost::shared_ptr<bin_statistics_ff> sptr;
@@ -45,8 +52,34 @@ namespace gr {
        * constructor is in a private implementation
        * class. msod_sensor::bin_statistics_ff::make is the public interface for
        * creating new instances.
+       *
+       * \param det detector for output 0: 0 average, 1 peak, 2 average
+       *        in the log domain (the mean of 10 log10(x), given back
+       *        as power, i.e. the geometric mean; it is less pulled up
+       *        by short strong signals than the average), 3 minimum,
+       *        4 percentile of each bin over the interval (a streaming
+       *        P^2 estimate), 5 max-hold with decay. Max-hold keeps the
+       *        largest value seen, multiplied by decay for every input
+       *        vector, across measurement intervals.
+       * \param more_dets detectors for outputs 1, 2, ...
+       * \param percentile the quantile for detector 4, between 0 and 1.
+       * \param decay factor applied per input vector by detector 5
+       *        (1 holds forever).
+       * \param output 0 writes the statistic as is (float). 1 writes
+       *        10 log10(statistic) + offset_db (float), for example dBm
+       *        with 30 as the offset, from power in W (|x|^2 in V^2
+       *        times the V^2 to W factor). 2 and 3 write that value
+       *        times scale, rounded and clipped to int16 or int8, which
+       *        replaces nlog10_ff and float_to_char/short after the
+       *        block.
+       * \param offset_db added to the dB value (outputs 1 to 3).
+       * \param scale applied to the dB value before the integer
+       *        conversion (outputs 2 and 3).
        */
-      static sptr make(unsigned int vlen, unsigned int meas_period, int det=0);
+      static sptr make(unsigned int vlen, unsigned int meas_period, int det=0,
+                       const std::vector<int> &more_dets=std::vector<int>(),
+                       float percentile=0.9, float decay=1.0,
+                       int output=0, float offset_db=0, float scale=1.0);
     };
 
   } // namespace msod_sensor
@@ -45,8 +45,13 @@ namespace gr {
        * constructor is in a private implementation
        * class. capture::capture_sink::make is the public interface for
        * creating new instances.
+       *
+       * \param chunksize total number of samples in one capture.
+       * \param pretrigger number of those samples taken from before the
+       *        trigger (kept in a circular history buffer). The remaining
+       *        chunksize - pretrigger samples follow the trigger.
        */
-      static sptr make(size_t itemsize, size_t chunksize, size_t samp_rate, char* capture_dir, int mongodb_port, char* event_url, int time_offset);
+      static sptr make(size_t itemsize, size_t chunksize, size_t samp_rate, char* capture_dir, int mongodb_port, char* event_url, int time_offset, size_t pretrigger=0);
 
       /*!
        * \brief Start capture
@@ -63,6 +68,140 @@ namespace gr {
        */
       virtual void set_event_message(char* event_message) = 0;
 
+      /*!
+       * \brief Configure the background capture writer.
+       *
+       * \param nbuffers number of capture buffers. One is filled by the
+       *        flowgraph while the others are queued for the writer thread.
+       * \param drop_policy what to do when a trigger arrives and every
+       *        buffer is busy: 0 drops the new capture, 1 drops the oldest
+       *        capture that the writer has not started on yet.
+       */
+      virtual void set_writer_policy(int nbuffers, int drop_policy) = 0;
+
+      /*!
+       * \brief Number of completed captures waiting for the writer.
+       */
+      virtual int queue_depth() = 0;
+
+      /*!
+       * \brief Number of captures dropped because no buffer was free.
+       */
+      virtual int dropped_captures() = 0;
+
+      /*!
+       * \brief Most memory (bytes) the capture buffers ever took at once.
+       * Buffers are allocated as captures need them, so in streaming
+       * mode this stays at a few segments, whatever the capture size.
+       */
+      virtual size_t peak_buffer_bytes() = 0;
+
+      /*!
+       * \brief Choose how captures get to disk.
+       *
+       * \param mode 0 fills a buffer in memory and writes it to the capture
+       *        file once the capture is complete. 1 preallocates the capture
+       *        file when the capture starts and maps it into memory, so the
+       *        samples go straight into the page cache as they arrive and
+       *        nothing is copied again at the end. The nbuffers setting
+       *        then limits the number of captures in flight. 2 streams the
+       *        capture: samples are collected in segment sized buffers
+       *        which are appended to the capture file as they fill, so the
+       *        capture length is not limited by memory. nbuffers is then
+       *        the number of segment buffers. If the disk cannot keep up
+       *        and no buffer is free, the capture is cut short.
+       */
+      virtual void set_file_mode(int mode) = 0;
+
+      /*!
+       * \brief Number of items per segment in streaming mode (default 65536).
+       */
+      virtual void set_segment_size(size_t nitems) = 0;
+
+      /*!
+       * \brief Write captures as SigMF recordings.
+       *
+       * When enabled each capture is stored as capture-<time>.sigmf-data
+       * with a capture-<time>.sigmf-meta JSON sidecar describing the data
+       * type, sample rate, center frequency, start time and sample index
+       * and the trigger position, so the files can be used without the
+       * database. Takes effect with the next capture.
+       */
+      virtual void set_sigmf_output(bool enable) = 0;
+
+      /*!
+       * \brief Center frequency (Hz) recorded in the SigMF metadata.
+       *
+       * If not set, the middle of fStart and fStop in the mPar field of
+       * the event message is used.
+       */
+      virtual void set_center_freq(double freq) = 0;
+
+      /*!
+       * \brief Sample format of the capture files.
+       *
+       * \param format 0 keeps the float samples as they are (fc32). 1 stores
+       *        each float as a 16 bit integer (sc16), 2 as an 8 bit integer
+       *        (sc8), which also shrinks the capture buffers by 2x or 4x.
+       * \param scale samples are multiplied by this before conversion and
+       *        clipped to the integer range. 0 picks full scale for a
+       *        [-1, 1] input (32767 or 127).
+       *
+       * Integer formats need an item made of floats (float or gr_complex).
+       * Takes effect with the next capture.
+       */
+      virtual void set_storage_format(int format, float scale=0) = 0;
+
+      /*!
+       * \brief Coalesce capture events into batched POSTs.
+       *
+       * \param max_events up to this many capture events that are written
+       *        back to back are sent to the event URL as one JSON array.
+       *        The batch is sent early when the writer runs out of work.
+       *        1 (the default) posts each event on its own.
+       */
+      virtual void set_event_batching(int max_events) = 0;
+
+      /*!
+       * \brief Keep capture events in a durable outbox until delivered.
+       *
+       * Events are appended to the log file at path and sent from a
+       * background thread. Failed POSTs are retried with exponential
+       * backoff (min_backoff doubling up to max_backoff seconds), so events
+       * survive server outages and restarts of the sensor. Call before
+       * the flowgraph starts; it can only be set once.
+       */
+      virtual void set_event_outbox(char* path, double min_backoff=1, double max_backoff=300) = 0;
+
+      /*!
+       * \brief Number of capture events in the outbox not yet delivered.
+       */
+      virtual int pending_events() = 0;
+
+      /*!
+       * \brief Where the capture records go.
+       *
+       * \param backend 0 inserts them into the local mongod on the port
+       *        given to make() (the default when that port is > 0). The
+       *        connection is made in the background and retried, so mongod
+       *        does not have to be up when the flowgraph starts. 1 appends
+       *        them to the file at path, one JSON document per line. 2
+       *        discards them (the default when the port is 0 or less).
+       * \param path file name for backend 1, ignored otherwise.
+       */
+      virtual void set_metadata_backend(int backend, char* path) = 0;
+
+      /*!
+       * \brief Whether mongod acknowledges each bulk insert of capture
+       * records (the default) before the next one goes out.
+       *
+       * Unacknowledged inserts cost no round trip, but a record mongod
+       * refuses is lost without an error. The writer is shared by all
+       * sinks using the same port, so this applies to all of them.
+       * Kept when the backend is changed.
+       */
+      virtual void set_metadata_acknowledged(bool acknowledged) = 0;
+
     };
 
   } // namespace capture
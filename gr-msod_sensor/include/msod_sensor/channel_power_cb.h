@@ -0,0 +1,81 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifndef INCLUDED_MSOD_SENSOR_CHANNEL_POWER_CB_H
+#define INCLUDED_MSOD_SENSOR_CHANNEL_POWER_CB_H
+
+#include <msod_sensor/api.h>
+#include <gnuradio/block.h>
+#include <vector>
+
+namespace gr {
+  namespace msod_sensor {
+
+    /*!
+     * \brief Channel power spectrum of a complex stream, in dBm, as int8.
+     * \ingroup msod_sensor
+     *
+     * Does the work of stream_to_vector, fft_vcc (forward, shifted),
+     * complex_to_mag_squared, bin_aggregator_ff, bin_statistics_ff,
+     * nlog10_ff and float_to_char in one pass over each FFT frame, so
+     * a frame goes through the cache once instead of seven times.
+     */
+    class MSOD_SENSOR_API channel_power_cb : virtual public gr::block
+    {
+     public:
+      typedef boost::shared_ptr<channel_power_cb> sptr;
+
+      /*!
+       * \brief Return a shared_ptr to a new instance of msod_sensor::channel_power_cb.
+       *
+       * To avoid accidental use of raw pointers, msod_sensor::channel_power_cb's
+       * constructor is in a private implementation
+       * class. msod_sensor::channel_power_cb::make is the public interface for
+       * creating new instances.
+       *
+       * \param fft_size FFT length.
+       * \param window window applied to each frame (fft_size taps, or
+       *        empty for none).
+       * \param num_ch number of channels in each output vector.
+       * \param bin_index channel (1 based, 0 for none) of each bin of
+       *        the shifted FFT, as for bin_aggregator_ff.
+       * \param meas_interval number of FFT frames in a measurement.
+       * \param det 0 averages the channel power over the measurement,
+       *        1 takes the peak.
+       * \param offset_db added to 10 log10 of the channel power, for
+       *        example the V^2 to W factor + 30 to get dBm.
+       */
+      static sptr make(unsigned int fft_size, const std::vector<float> &window,
+                       unsigned int num_ch, const std::vector<unsigned int> &bin_index,
+                       unsigned int meas_interval, int det=0, float offset_db=0);
+
+      /*!
+       * \brief Set bin index array
+       */
+      virtual void set_bin_index(const std::vector<unsigned int> &bin_index) = 0;
+    };
+
+  } // namespace msod_sensor
+} // namespace gr
+
+#endif /* INCLUDED_MSOD_SENSOR_CHANNEL_POWER_CB_H */
+
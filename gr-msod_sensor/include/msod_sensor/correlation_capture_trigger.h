@@ -0,0 +1,95 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef INCLUDED_MSOD_SENSOR_CORRELATION_CAPTURE_TRIGGER_H
+#define INCLUDED_MSOD_SENSOR_CORRELATION_CAPTURE_TRIGGER_H
+
+#include <msod_sensor/api.h>
+#include <gnuradio/sync_block.h>
+#include <vector>
+
+namespace gr {
+  namespace msod_sensor {
+
+    /*!
+     * \brief Capture trigger on the presence of known sequences (e.g. the
+     * LTE PSS) in a complex stream.
+     * \ingroup msod_sensor
+     *
+     * Cross-correlates the input with each reference sequence by
+     * overlap-save fast convolution: one forward FFT per block of input
+     * and one inverse FFT per reference. Once armed it fires when the
+     * normalized correlation
+     *
+     *   |sum x[n+k] conj(r[k])| / sqrt(sum |x[n+k]|^2 * sum |r[k]|^2)
+     *
+     * of any reference exceeds the threshold, so the trigger does not
+     * depend on the signal level. One shot, like level_capture_trigger.
+     *
+     * The trigger message carries the offset of the first sample of the
+     * matched sequence, its length as the window, the index of the
+     * reference and the correlation.
+     */
+    class MSOD_SENSOR_API correlation_capture_trigger : virtual public gr::sync_block
+    {
+     public:
+      typedef boost::shared_ptr<correlation_capture_trigger> sptr;
+
+      /*!
+       * \brief Return a shared_ptr to a new instance of msod_sensor::correlation_capture_trigger.
+       *
+       * \param references the sequences to look for, as complex samples
+       *        at the input sample rate.
+       * \param threshold normalized correlation (0 to 1) to fire at.
+       * \param fft_size FFT length, at least that of the longest
+       *        reference. Each FFT covers fft_size - length + 1 new
+       *        samples. 0 picks a power of two of four to eight times
+       *        the longest reference.
+       */
+      static sptr make(const std::vector<std::vector<gr_complex> > &references,
+                       float threshold, unsigned int fft_size=0);
+
+      /*!
+       * \brief Start capture
+       */
+      virtual void arm() = 0;
+
+      /*!
+       * \brief Stop capture.
+       */
+      virtual void disarm() = 0;
+
+      /*!
+       * \brief True while armed (until the trigger fires or disarm()).
+       */
+      virtual bool is_armed() = 0;
+
+      /*!
+       * \brief Set the normalized correlation to fire at.
+       */
+      virtual void set_threshold(float threshold) = 0;
+    };
+
+  } // namespace msod_sensor
+} // namespace gr
+
+#endif /* INCLUDED_MSOD_SENSOR_CORRELATION_CAPTURE_TRIGGER_H */
+
@@ -45,8 +45,38 @@ namespace gr {
        * constructor is in a private implementation
        * class. msod_sensor::iqcapture_sink::make is the public interface for
        * creating new instances.
+       *
+       * \param chunksize number of most recent items kept and written out on capture.
+       * \param double_mapped map the history buffer twice in virtual memory
+       *        so it never has to be split at the wrap point.
+       * \param samp_rate sample rate, used to time stamp captures (0 if unknown;
+       *        an rx_rate tag from the source overrides it).
+       */
+      static sptr make(size_t itemsize, size_t chunksize, char* capture_dir, int mongodb_port, bool double_mapped=false, double samp_rate=0);
+
+      /*!
+       * \brief Where the capture records go.
+       *
+       * \param backend 0 inserts them into the local mongod on the port
+       *        given to make() (the default when that port is > 0). The
+       *        connection is made in the background and retried, so mongod
+       *        does not have to be up when the flowgraph starts. 1 appends
+       *        them to the file at path, one JSON document per line. 2
+       *        discards them (the default when the port is 0 or less).
+       * \param path file name for backend 1, ignored otherwise.
+       */
+      virtual void set_metadata_backend(int backend, char* path) = 0;
+
+      /*!
+       * \brief Whether mongod acknowledges each bulk insert of capture
+       * records (the default) before the next one goes out.
+       *
+       * Unacknowledged inserts cost no round trip, but a record mongod
+       * refuses is lost without an error. The writer is shared by all
+       * sinks using the same port, so this applies to all of them.
+       * Kept when the backend is changed.
        */
-      static sptr make(size_t itemsize, size_t chunksize, char* capture_dir, int mongodb_port);
+      virtual void set_metadata_acknowledged(bool acknowledged) = 0;
     };
 
   } // namespace msod_sensor
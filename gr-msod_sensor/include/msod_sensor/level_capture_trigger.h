@@ -24,6 +24,7 @@
 
 #include <msod_sensor/api.h>
 #include <gnuradio/block.h>
+#include <vector>
 
 namespace gr {
   namespace msod_sensor {
@@ -45,8 +46,16 @@ namespace gr {
        * constructor is in a private implementation
        * class. msod_sensor::level_capture_trigger::make is the public interface for
        * creating new instances.
+       *
+       * \param level trigger level in dBm.
+       * \param window_size number of samples the power is averaged over.
+       * \param mode 0 averages over disjoint windows, 1 over a window that
+       *        slides by one sample.
+       * \param window_sizes additional window lengths evaluated in the same
+       *        pass. The trigger message reports which window fired.
        */
-      static sptr make(size_t itemsize, int level, size_t window_size);
+      static sptr make(size_t itemsize, int level, size_t window_size, int mode=0,
+                       const std::vector<unsigned int> &window_sizes=std::vector<unsigned int>());
 
       /*!
        * \brief Start capture
@@ -57,6 +66,38 @@ namespace gr {
        * \brief Stop capture.
        */
       virtual void disarm() = 0;
+
+      /*!
+       * \brief True while armed (until the trigger fires or disarm()).
+       */
+      virtual bool is_armed() = 0;
+
+      /*!
+       * \brief Set what the trigger does once armed, from a JSON object
+       * (the triggerParams of an arm command).
+       *
+       * Keys (all optional, the rest stay as they are):
+       *  - "level": trigger level in dBm.
+       *  - "holdoff": negative (the default) for one shot: disarm after
+       *    firing. Otherwise stay armed and look again this many seconds
+       *    after firing, without a new arm command.
+       *  - "hysteresis": if > 0, after firing the power has to drop this
+       *    many dB below the level before the trigger fires again, so a
+       *    long burst fires once. 0 (the default) fires again after the
+       *    holdoff for as long as the power stays over the level.
+       *  - "maxPerMinute": at most this many triggers in any 60 seconds
+       *    (default 0, no limit).
+       *  - "cfarMargin": if > 0, "level" is ignored and the trigger fires
+       *    this many dB above the noise floor instead. The floor is the
+       *    lowest power of the last "cfarWindows" (default 32) disjoint
+       *    windows, tracked whether or not the trigger is armed, so it
+       *    follows gain and temperature changes. Nothing fires until that
+       *    many windows have been seen.
+       *
+       * Can be called from a process forked from the flowgraph's, as the
+       * sslsocket_sink command handler does.
+       */
+      virtual void set_trigger_params(char* params) = 0;
     };
 
   } // namespace msod_sensor
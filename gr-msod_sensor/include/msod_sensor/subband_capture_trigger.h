@@ -0,0 +1,108 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef INCLUDED_MSOD_SENSOR_SUBBAND_CAPTURE_TRIGGER_H
+#define INCLUDED_MSOD_SENSOR_SUBBAND_CAPTURE_TRIGGER_H
+
+#include <msod_sensor/api.h>
+#include <gnuradio/sync_block.h>
+#include <vector>
+
+namespace gr {
+  namespace msod_sensor {
+
+    /*!
+     * \brief Capture trigger on the power in selected channels of a
+     * spectrum vector.
+     * \ingroup msod_sensor
+     *
+     * Takes the |X|^2 vectors of the spectrum path (complex_to_mag_squared
+     * or bin_aggregator_ff) and tracks the noise floor of each selected
+     * channel. Once armed it fires when a channel rises the given number
+     * of dB above its floor, so signals outside the channels of interest
+     * don't trigger a capture. Like level_capture_trigger it is one shot
+     * and has to be armed again after firing.
+     */
+    class MSOD_SENSOR_API subband_capture_trigger : virtual public gr::sync_block
+    {
+     public:
+      typedef boost::shared_ptr<subband_capture_trigger> sptr;
+
+      /*!
+       * \brief Return a shared_ptr to a new instance of msod_sensor::subband_capture_trigger.
+       *
+       * \param vlen length of the input vectors.
+       * \param channels elements of the vector to watch (0 based). Empty
+       *        watches all of them.
+       * \param thresholds dB above the noise floor, one per channel, or a
+       *        single value for all channels.
+       * \param samples_per_vector I/Q samples behind each vector (FFT size
+       *        times any decimation in between). If not 0 the trigger
+       *        message carries the sample offset, so a capture sink on the
+       *        I/Q stream can line its capture up with it.
+       * \param floor_alpha weight of each new vector in the average
+       *        power of a channel.
+       * \param warmup vectors averaged into the floor before the trigger
+       *        can fire.
+       * \param floor_window the floor is the lowest average power of
+       *        the last floor_window vectors. A signal that stays on
+       *        for less than that leaves the floor alone; a rise of the
+       *        floor (gain, temperature, a new carrier) is followed
+       *        after floor_window vectors, and the trigger stops firing
+       *        on it.
+       */
+      static sptr make(unsigned int vlen, const std::vector<unsigned int> &channels,
+                       const std::vector<float> &thresholds, size_t samples_per_vector=0,
+                       float floor_alpha=0.01, unsigned int warmup=16,
+                       unsigned int floor_window=1000);
+
+      /*!
+       * \brief Start capture
+       */
+      virtual void arm() = 0;
+
+      /*!
+       * \brief Stop capture.
+       */
+      virtual void disarm() = 0;
+
+      /*!
+       * \brief True while armed (until the trigger fires or disarm()).
+       */
+      virtual bool is_armed() = 0;
+
+      /*!
+       * \brief Set the thresholds (dB above the floor, one per channel or
+       * a single value).
+       */
+      virtual void set_thresholds(const std::vector<float> &thresholds) = 0;
+
+      /*!
+       * \brief Current noise floor of each channel (dB).
+       */
+      virtual std::vector<float> noise_floor() = 0;
+    };
+
+  } // namespace msod_sensor
+} // namespace gr
+
+#endif /* INCLUDED_MSOD_SENSOR_SUBBAND_CAPTURE_TRIGGER_H */
+
@@ -23,6 +23,8 @@
 #endif
 
 #include <gnuradio/io_signature.h>
+#include <stdexcept>
+#include <string.h>
 #include "bin_aggregator_ff_impl.h"
 
 namespace gr {
@@ -43,8 +45,11 @@ bin_aggregator_ff_impl::bin_aggregator_ff_impl(unsigned int input_vlen, unsigned
                      gr::io_signature::make(1, 1, input_vlen * sizeof(float)),
                      gr::io_signature::make(1, 1, output_vlen * sizeof(float))),
     d_input_vlen(input_vlen), d_output_vlen(output_vlen),
-    d_output_bin_index(output_bin_index)
-{}
+    d_output_bin_index(output_bin_index), d_map(input_vlen, output_vlen)
+{
+    d_output_bin_index.resize(input_vlen, 0);
+    d_map.set_index(d_output_bin_index);
+}
 
 /*
  * Our virtual destructor.
@@ -58,7 +63,12 @@ void
 bin_aggregator_ff_impl::set_bin_index(
     const std::vector<unsigned int> &output_bin_index)
 {
+    if (output_bin_index.size() < d_input_vlen) {
+        throw std::invalid_argument("bin_aggregator_ff: bin index shorter than the input vector");
+    }
+    gr::thread::scoped_lock guard(d_mutex);
     memcpy(&d_output_bin_index[0], &output_bin_index[0], d_input_vlen * sizeof(unsigned int));
+    d_map.set_index(d_output_bin_index);
 }
 
 int
@@ -69,12 +79,10 @@ bin_aggregator_ff_impl::work(int noutput_items,
     const float *in = (const float *) input_items[0];
     float *out = (float *) output_items[0];
 
+    gr::thread::scoped_lock guard(d_mutex);
+    memset(out, 0, noutput_items * d_output_vlen * sizeof(float));
     for (int n = 0; n < noutput_items; n++) {
-        for (int i = 0; i < d_output_vlen; i++)
-            out[n * d_output_vlen + i] = 0.0;
-        for (int i = 0; i < d_input_vlen; i++)
-            if ((d_output_bin_index[i] > 0) && (d_output_bin_index[i] <= d_output_vlen))
-                out[n * d_output_vlen + d_output_bin_index[i] - 1] += in[n * d_input_vlen + i];
+        d_map.accumulate(in + n * d_input_vlen, out + n * d_output_vlen);
     }
 
     // Tell runtime system how many output items we produced.
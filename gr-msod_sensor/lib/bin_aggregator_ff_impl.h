@@ -22,6 +22,8 @@
 #define INCLUDED_MYBLOCKS_BIN_AGGREGATOR_FF_IMPL_H
 
 #include <msod_sensor/bin_aggregator_ff.h>
+#include <gnuradio/thread/thread.h>
+#include "channel_map.h"
 
 namespace gr {
   namespace msod_sensor {
@@ -32,6 +34,9 @@ namespace gr {
       unsigned int d_input_vlen;
       unsigned int d_output_vlen;
       std::vector<unsigned int> d_output_bin_index;
+      // The bin index compiled into runs of bins.
+      channel_map d_map;
+      gr::thread::mutex d_mutex;
 
      public:
       void set_bin_index(const std::vector<unsigned int> &output_bin_index);
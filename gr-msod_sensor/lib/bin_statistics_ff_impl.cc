@@ -23,85 +23,253 @@
 #endif
 
 #include <algorithm> /* copy */
+#include <stdexcept>
+#include <string>
+#include <math.h>
 
 #include <gnuradio/io_signature.h>
 #include <volk/volk.h>
 #include "bin_statistics_ff_impl.h"
+#include "power_db.h"
 
 namespace gr {
 namespace msod_sensor {
 
 bin_statistics_ff::sptr
-bin_statistics_ff::make(unsigned int vlen, unsigned int meas_interval, int det)
+bin_statistics_ff::make(unsigned int vlen, unsigned int meas_interval, int det,
+                        const std::vector<int> &more_dets, float percentile, float decay,
+                        int output, float offset_db, float scale)
 {
     return gnuradio::get_initial_sptr
-           (new bin_statistics_ff_impl(vlen, meas_interval, det));
+           (new bin_statistics_ff_impl(vlen, meas_interval, det, more_dets, percentile, decay,
+                                       output, offset_db, scale));
 }
 
-/*
- * The private constructor
- */
-bin_statistics_ff_impl::bin_statistics_ff_impl(unsigned int vlen, unsigned int meas_interval, int det)
-    : gr::sync_decimator("bin_statistics_ff",
-                         gr::io_signature::make(1, 1, vlen * sizeof(float)),
-                         gr::io_signature::make(1, 1, vlen * sizeof(float)), meas_interval),
-    d_vlen(vlen), d_meas_interval(meas_interval), d_det(det)
-{}
+static size_t
+output_item_size(int output)
+{
+    switch (output) {
+    case 2:
+        return sizeof(int16_t);
+    case 3:
+        return sizeof(int8_t);
+    default:
+        return sizeof(float);
+    }
+}
+
+bin_statistics_ff_impl::bin_statistics_ff_impl(unsigned int vlen, unsigned int meas_interval, int det,
+                                               const std::vector<int> &more_dets, float percentile, float decay,
+                                               int output, float offset_db, float scale)
+    : gr::block("bin_statistics_ff",
+                gr::io_signature::make(1, 1, vlen * sizeof(float)),
+                gr::io_signature::make(1, 1 + more_dets.size(), vlen * output_item_size(output))),
+    d_vlen(vlen), d_meas_interval(meas_interval), d_count(0),
+    d_percentile(percentile), d_decay(decay), d_held(false),
+    d_output(output), d_offset_db(offset_db), d_scale(scale)
+{
+    if (output < OUT_LINEAR || output > OUT_INT8) {
+        throw std::invalid_argument("bin_statistics_ff: unknown output format " + std::to_string(output));
+    }
+    if (percentile <= 0 || percentile >= 1) {
+        throw std::invalid_argument("bin_statistics_ff: percentile must be between 0 and 1");
+    }
+    std::vector<int> dets(1, det);
+    dets.insert(dets.end(), more_dets.begin(), more_dets.end());
+    for (size_t k = 0; k < dets.size(); k++) {
+        if (dets[k] < AVG || dets[k] > MAX_HOLD) {
+            throw std::invalid_argument("bin_statistics_ff: unknown detector " + std::to_string(dets[k]));
+        }
+        detector d;
+        d.det = dets[k];
+        if (d.det == PERCENTILE) {
+            d.quantiles.resize(vlen);
+        } else {
+            d.acc.resize(vlen);
+        }
+        d_detectors.push_back(d);
+    }
+    d_tmp = (float*) volk_malloc(vlen * sizeof(float), volk_get_alignment());
+    d_log = (float*) volk_malloc(vlen * sizeof(float), volk_get_alignment());
+    set_relative_rate(1.0 / meas_interval);
+}
 
-/*
- * Our virtual destructor.
- */
 bin_statistics_ff_impl::~bin_statistics_ff_impl()
 {
+    volk_free(d_tmp);
+    volk_free(d_log);
 }
 
-int
-bin_statistics_ff_impl::work(int noutput_items,
-                             gr_vector_const_void_star &input_items,
-                             gr_vector_void_star &output_items)
+void
+bin_statistics_ff_impl::forecast (int noutput_items, gr_vector_int &ninput_items_required)
 {
-    const float *in = (const float *) input_items[0];
-    float *out = (float *) output_items[0];
+    // The statistic is carried across calls; any input moves it along.
+    ninput_items_required[0] = 1;
+}
 
-    if (d_meas_interval == 1)
-    {
-        // No averaging required, copy all
-        std::copy(in, &in[d_vlen * noutput_items], out);
+// Fold one input vector into the detector state. first is set for the
+// first vector of a measurement interval.
+void
+bin_statistics_ff_impl::update(detector& d, const float* x, bool first)
+{
+    switch (d.det) {
+    case AVG:
+        if (first) {
+            std::copy(x, x + d_vlen, d.acc.begin());
+        } else {
+            volk_32f_x2_add_32f(&d.acc[0], &d.acc[0], x, d_vlen);
+        }
+        break;
+    case PEAK:
+        if (first) {
+            std::copy(x, x + d_vlen, d.acc.begin());
+        } else {
+            volk_32f_x2_max_32f(&d.acc[0], &d.acc[0], x, d_vlen);
+        }
+        break;
+    case LOG_AVG:
+        power_to_log2(d_log, x, d_vlen);
+        if (first) {
+            std::copy(d_log, d_log + d_vlen, d.acc.begin());
+        } else {
+            volk_32f_x2_add_32f(&d.acc[0], &d.acc[0], d_log, d_vlen);
+        }
+        break;
+    case MIN:
+        if (first) {
+            std::copy(x, x + d_vlen, d.acc.begin());
+        } else {
+            volk_32f_x2_min_32f(&d.acc[0], &d.acc[0], x, d_vlen);
+        }
+        break;
+    case PERCENTILE:
+        for (unsigned int i = 0; i < d_vlen; i++) {
+            if (first) {
+                d.quantiles[i].reset(d_percentile);
+            }
+            d.quantiles[i].add(x[i]);
+        }
+        break;
+    case MAX_HOLD:
+        // Not reset by the interval: decay what is held, then take the max.
+        if (!d_held) {
+            std::copy(x, x + d_vlen, d.acc.begin());
+        } else {
+            if (d_decay != 1) {
+                volk_32f_s32f_multiply_32f(&d.acc[0], &d.acc[0], d_decay, d_vlen);
+            }
+            volk_32f_x2_max_32f(&d.acc[0], &d.acc[0], x, d_vlen);
+        }
+        break;
     }
-    else
-    {
-        // Apply statistic to the input vectors in the measurement interval
-        for (size_t n = 0; n < noutput_items; ++n)
-        {
-            std::copy(&in[n * d_vlen * d_meas_interval],
-                      &in[n * d_vlen * d_meas_interval + d_vlen],
-                      &out[n * d_vlen]);
+}
 
-            for (size_t i = 1; i < d_meas_interval; ++i)
-            {
-                if (d_det == AVG) {
-                    volk_32f_x2_add_32f(&out[n * d_vlen],
-                                        &out[n * d_vlen],
-                                        &in[(n * d_meas_interval + i) * d_vlen],
-                                        d_vlen);
-                } else if (d_det == PEAK) {
-                    volk_32f_x2_max_32f(&out[n * d_vlen],
-                                        &out[n * d_vlen],
-                                        &in[(n * d_meas_interval + i) * d_vlen],
-                                        d_vlen);
-                }
+// Fold in the last vector of the interval and write the statistic to y.
+void
+bin_statistics_ff_impl::finish(detector& d, const float* x, float* y)
+{
+    // divide by d_meas_interval = multiply by 1/d_meas_interval,
+    // in the same pass as the last add.
+    const float scalar = 1 / static_cast<float>(d_meas_interval);
+    bool first = d_meas_interval == 1;
+    switch (d.det) {
+    case AVG:
+        if (first) {
+            std::copy(x, x + d_vlen, y);
+        } else {
+            for (unsigned int i = 0; i < d_vlen; i++) {
+                y[i] = (d.acc[i] + x[i]) * scalar;
+            }
+        }
+        break;
+    case PEAK:
+        if (first) {
+            std::copy(x, x + d_vlen, y);
+        } else {
+            volk_32f_x2_max_32f(y, &d.acc[0], x, d_vlen);
+        }
+        break;
+    case LOG_AVG:
+        // Mean of log2, back to power (the geometric mean), so the dB
+        // outputs come out as the mean of the dB values.
+        power_to_log2(d_log, x, d_vlen);
+        for (unsigned int i = 0; i < d_vlen; i++) {
+            y[i] = exp2f(((first ? 0 : d.acc[i]) + d_log[i]) * scalar);
+        }
+        break;
+    case MIN:
+        if (first) {
+            std::copy(x, x + d_vlen, y);
+        } else {
+            volk_32f_x2_min_32f(y, &d.acc[0], x, d_vlen);
+        }
+        break;
+    case PERCENTILE:
+        for (unsigned int i = 0; i < d_vlen; i++) {
+            if (first) {
+                d.quantiles[i].reset(d_percentile);
             }
+            d.quantiles[i].add(x[i]);
+            y[i] = d.quantiles[i].value();
         }
+        break;
+    case MAX_HOLD:
+        update(d, x, false);
+        std::copy(d.acc.begin(), d.acc.end(), y);
+        break;
+    }
+}
 
-        if (d_det == AVG) {
-            // divide by d_meas_interval = multiply by 1/d_meas_interval
-            const float scalar = 1 / static_cast<float>(d_meas_interval);
-            volk_32f_s32f_multiply_32f(out, out, scalar, d_vlen * noutput_items);
+int
+bin_statistics_ff_impl::general_work(int noutput_items,
+                                     gr_vector_int &ninput_items,
+                                     gr_vector_const_void_star &input_items,
+                                     gr_vector_void_star &output_items)
+{
+    const float *in = (const float *) input_items[0];
+    // Only the detectors whose outputs are connected are computed.
+    size_t ndet = std::min(output_items.size(), d_detectors.size());
+
+    int consumed = 0;
+    int produced = 0;
+    while (consumed < ninput_items[0] && produced < noutput_items) {
+        const float* x = &in[consumed * d_vlen];
+        if (d_count + 1 == d_meas_interval) {
+            // Last vector of the interval: finish straight into the outputs.
+            for (size_t k = 0; k < ndet; k++) {
+                if (d_output == OUT_LINEAR || d_output == OUT_DB) {
+                    float* out = (float *) output_items[k] + produced * d_vlen;
+                    finish(d_detectors[k], x, out);
+                    if (d_output == OUT_DB) {
+                        power_to_db(out, out, d_vlen, d_offset_db);
+                    }
+                } else {
+                    finish(d_detectors[k], x, d_tmp);
+                    power_to_db(d_tmp, d_tmp, d_vlen, d_offset_db);
+                    if (d_output == OUT_INT16) {
+                        int16_t* out = (int16_t *) output_items[k] + produced * d_vlen;
+                        volk_32f_s32f_convert_16i(out, d_tmp, d_scale, d_vlen);
+                    } else {
+                        int8_t* out = (int8_t *) output_items[k] + produced * d_vlen;
+                        volk_32f_s32f_convert_8i(out, d_tmp, d_scale, d_vlen);
+                    }
+                }
+            }
+            produced++;
+            d_count = 0;
+        } else {
+            for (size_t k = 0; k < ndet; k++) {
+                update(d_detectors[k], x, d_count == 0);
+            }
+            d_count++;
         }
+        d_held = true;
+        consumed++;
     }
 
+    consume_each(consumed);
     // Tell runtime system how many output items we produced.
-    return noutput_items;
+    return produced;
 }
 
 } /* namespace msod_sensor */
@@ -22,6 +22,7 @@
 #define INCLUDED_MYBLOCKS_BIN_STATISTICS_FF_IMPL_H
 
 #include <msod_sensor/bin_statistics_ff.h>
+#include "p2_quantile.h"
 
 namespace gr {
   namespace msod_sensor {
@@ -31,15 +32,46 @@ namespace gr {
      private:
       unsigned int d_vlen;
       unsigned int d_meas_interval;
-      enum Det {AVG, PEAK};
-      int d_det;
+      enum Det {AVG, PEAK, LOG_AVG, MIN, PERCENTILE, MAX_HOLD};
+      // One statistic, computed for one output port.
+      struct detector {
+        int det;
+        // Running sum (AVG), sum of log2 (LOG_AVG), max (PEAK, MAX_HOLD)
+        // or min (MIN) of the vectors seen so far.
+        std::vector<float> acc;
+        // Per bin quantile estimate (PERCENTILE).
+        std::vector<p2_quantile> quantiles;
+      };
+      std::vector<detector> d_detectors;
+      // Number of vectors seen so far in the current measurement interval.
+      unsigned int d_count;
+      float d_percentile;
+      float d_decay;
+      // MAX_HOLD carries over between intervals; false until the first vector.
+      bool d_held;
+      enum Output {OUT_LINEAR, OUT_DB, OUT_INT16, OUT_INT8};
+      int d_output;
+      float d_offset_db;
+      float d_scale;
+      // The statistic before integer conversion (volk aligned).
+      float* d_tmp;
+      // log2 of the current input vector (LOG_AVG, volk aligned).
+      float* d_log;
+
+      void update(detector& d, const float* x, bool first);
+      void finish(detector& d, const float* x, float* y);
 
      public:
-      bin_statistics_ff_impl(unsigned int vlen, unsigned int meas_interval, int det);
+      bin_statistics_ff_impl(unsigned int vlen, unsigned int meas_interval, int det,
+                             const std::vector<int> &more_dets, float percentile, float decay,
+                             int output, float offset_db, float scale);
       ~bin_statistics_ff_impl();
 
+      void forecast (int noutput_items, gr_vector_int &ninput_items_required);
+
       // Where all the action really happens
-      int work(int noutput_items,
+      int general_work(int noutput_items,
+	       gr_vector_int &ninput_items,
 	       gr_vector_const_void_star &input_items,
 	       gr_vector_void_star &output_items);
     };
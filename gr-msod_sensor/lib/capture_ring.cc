@@ -0,0 +1,163 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <algorithm>
+#include "capture_ring.h"
+
+namespace gr {
+namespace msod_sensor {
+
+// Map a file twice back to back so that the ring's storage is mirrored
+// right after itself. Returns NULL if any step fails.
+static char*
+map_mirrored(size_t size)
+{
+    char path[] = "/tmp/msod_sensor_ring-XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        return NULL;
+    }
+    unlink(path);
+    if (ftruncate(fd, size) != 0) {
+        close(fd);
+        return NULL;
+    }
+    // Reserve the address range, then place both views of the file inside it.
+    void* base = mmap(NULL, 2 * size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+        close(fd);
+        return NULL;
+    }
+    char* first = (char*) base;
+    if (mmap(first, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED
+            || mmap(first + size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        munmap(base, 2 * size);
+        close(fd);
+        return NULL;
+    }
+    // The mappings keep the file alive.
+    close(fd);
+    return first;
+}
+
+capture_ring::capture_ring(size_t itemsize, size_t min_items, bool double_mapped)
+{
+    d_itemsize = itemsize;
+    d_capacity = 1;
+    while (d_capacity < min_items) {
+        d_capacity <<= 1;
+    }
+    d_buffer = NULL;
+    d_double_mapped = false;
+    if (double_mapped) {
+        // Each view has to be a whole number of pages.
+        size_t page = sysconf(_SC_PAGESIZE);
+        while ((d_capacity * d_itemsize) % page != 0) {
+            d_capacity <<= 1;
+        }
+        d_buffer = map_mirrored(d_capacity * d_itemsize);
+        d_double_mapped = d_buffer != NULL;
+    }
+    if (d_buffer == NULL) {
+        d_buffer = new char[d_capacity * d_itemsize];
+    }
+    d_mask = d_capacity - 1;
+    d_written = 0;
+}
+
+capture_ring::~capture_ring()
+{
+    if (d_double_mapped) {
+        munmap(d_buffer, 2 * d_capacity * d_itemsize);
+    } else {
+        delete[] d_buffer;
+    }
+}
+
+size_t
+capture_ring::available() const {
+    return d_written < d_capacity ? (size_t) d_written : d_capacity;
+}
+
+void
+capture_ring::write(const void* in, size_t nitems) {
+    const char* src = (const char*) in;
+    if (nitems > d_capacity) {
+        // Only the most recent d_capacity items survive anyway.
+        src += (nitems - d_capacity) * d_itemsize;
+        d_written += nitems - d_capacity;
+        nitems = d_capacity;
+    }
+    size_t pos = d_written & d_mask;
+    size_t first = d_double_mapped ? nitems : std::min(nitems, d_capacity - pos);
+    memcpy(d_buffer + pos * d_itemsize, src, first * d_itemsize);
+    if (first < nitems) {
+        memcpy(d_buffer, src + first * d_itemsize, (nitems - first) * d_itemsize);
+    }
+    d_written += nitems;
+}
+
+int
+capture_ring::regions(struct iovec* iov, uint64_t end, size_t nitems) const {
+    uint64_t oldest = d_written - available();
+    if (end > d_written) {
+        end = d_written;
+    }
+    if (end <= oldest) {
+        return 0;
+    }
+    if (nitems > end - oldest) {
+        nitems = end - oldest;
+    }
+    size_t pos = (end - nitems) & d_mask;
+    size_t first = d_double_mapped ? nitems : std::min(nitems, d_capacity - pos);
+    iov[0].iov_base = d_buffer + pos * d_itemsize;
+    iov[0].iov_len = first * d_itemsize;
+    if (first == nitems) {
+        return 1;
+    }
+    iov[1].iov_base = d_buffer;
+    iov[1].iov_len = (nitems - first) * d_itemsize;
+    return 2;
+}
+
+size_t
+capture_ring::copy_out(void* out, uint64_t end, size_t nitems) const {
+    struct iovec iov[2];
+    int count = regions(iov, end, nitems);
+    char* dst = (char*) out;
+    size_t nbytes = 0;
+    for (int i = 0; i < count; i++) {
+        memcpy(dst + nbytes, iov[i].iov_base, iov[i].iov_len);
+        nbytes += iov[i].iov_len;
+    }
+    return nbytes / d_itemsize;
+}
+
+} /* namespace msod_sensor */
+} /* namespace gr */
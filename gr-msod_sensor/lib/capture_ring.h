@@ -0,0 +1,78 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_MSOD_SENSOR_CAPTURE_RING_H
+#define INCLUDED_MSOD_SENSOR_CAPTURE_RING_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/uio.h>
+
+namespace gr {
+  namespace msod_sensor {
+
+    /*!
+     * Fixed size history of the most recent items seen by a block.
+     * The capacity is rounded up to a power of two so that positions
+     * are computed with a mask. There is a single writer and reader
+     * (the block thread) so no locking is needed.
+     *
+     * Optionally the storage is mapped twice back to back in virtual
+     * memory, so any run of up to capacity items is contiguous and
+     * reads and writes never have to be split at the wrap point.
+     */
+    class capture_ring
+    {
+     private:
+      char*    d_buffer;
+      bool     d_double_mapped;
+      size_t   d_itemsize;
+      size_t   d_capacity;
+      size_t   d_mask;
+      // Total number of items ever written (absolute item index of the next write).
+      uint64_t d_written;
+
+     public:
+      capture_ring(size_t itemsize, size_t min_items, bool double_mapped=false);
+      ~capture_ring();
+
+      size_t capacity() const { return d_capacity; }
+      // False if a double mapping was asked for but could not be set up.
+      bool double_mapped() const { return d_double_mapped; }
+      uint64_t items_written() const { return d_written; }
+      // Number of items currently held (less than capacity until the ring fills).
+      size_t available() const;
+
+      // Append nitems. If nitems exceeds the capacity only the tail is kept.
+      void write(const void* in, size_t nitems);
+
+      // Copy out the nitems that end just before absolute item index end.
+      // Returns the number of items actually copied (limited by what is held).
+      size_t copy_out(void* out, uint64_t end, size_t nitems) const;
+
+      // Describe the same items as copy_out() in place, for writev().
+      // Fills at most two entries of iov and returns how many were used.
+      int regions(struct iovec* iov, uint64_t end, size_t nitems) const;
+    };
+
+  } // namespace msod_sensor
+} // namespace gr
+
+#endif /* INCLUDED_MSOD_SENSOR_CAPTURE_RING_H */
@@ -34,12 +34,15 @@
 #include <fstream>
 #include <iostream>
 #include <exception>
+#include <algorithm>
 #undef NDEBUG
 #include <cassert>
+#include <sys/mman.h>
+#include <errno.h>
+#include <sstream>
+#include <iomanip>
 #include "capture_sink_impl.h"
-#include <curl/curl.h>
-#include <boost/interprocess/anonymous_shared_memory.hpp>
-#include <boost/interprocess/mapped_region.hpp>
+#include <volk/volk.h>
 
 
 
@@ -48,21 +51,45 @@
 namespace gr {
 namespace msod_sensor {
 
+// Extra history kept beyond the pre-trigger samples. A trigger block on a
+// parallel branch of the flowgraph runs up to a buffer's worth of samples
+// ahead or behind this sink, and its trigger offset must still be in the ring.
+static const size_t TRIGGER_LAG_ITEMS = 65536;
+
+// write() all of nbytes, through short writes and signals.
+static bool
+write_all(int fd, const char* data, size_t nbytes)
+{
+    size_t written = 0;
+    while (written < nbytes) {
+        ssize_t n = write(fd, data + written, nbytes - written);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        written += n;
+    }
+    return true;
+}
+
 
 capture_sink::sptr
-capture_sink::make(size_t itemsize, size_t chunksize, size_t samp_rate, char* capture_dir, int mongodb_port, char* event_url, int time_offset)
+capture_sink::make(size_t itemsize, size_t chunksize, size_t samp_rate, char* capture_dir, int mongodb_port, char* event_url, int time_offset, size_t pretrigger)
 {
     return gnuradio::get_initial_sptr
-           (new capture_sink_impl(itemsize, chunksize, samp_rate, capture_dir,mongodb_port,event_url,time_offset));
+           (new capture_sink_impl(itemsize, chunksize, samp_rate, capture_dir,mongodb_port,event_url,time_offset,pretrigger));
 }
 
 /*
  * The private constructor
  */
-capture_sink_impl::capture_sink_impl(size_t itemsize, size_t chunksize, size_t samp_rate, char* capture_dir, int mongodb_port, char* event_url, int time_offset)
+capture_sink_impl::capture_sink_impl(size_t itemsize, size_t chunksize, size_t samp_rate, char* capture_dir, int mongodb_port, char* event_url, int time_offset, size_t pretrigger)
     :gr::sync_block("capture_sink",
                     gr::io_signature::make(1, 1, itemsize),
-                    gr::io_signature::make(0, 0, 0))
+                    gr::io_signature::make(0, 0, 0)),
+     d_clock(samp_rate)
 {
     prefs *p = prefs::singleton();
 #ifdef IQCAPTURE_DEBUG
@@ -72,9 +99,11 @@ capture_sink_impl::capture_sink_impl(size_t itemsize, size_t chunksize, size_t s
 #endif
     GR_LOG_SET_LEVEL(d_debug_logger,log_level);
     GR_LOG_DEBUG(d_debug_logger,"capture_sink_impl:: itemsize = " + std::to_string(itemsize) + " chunksize = " + std::to_string(chunksize) +
-                 " capture_dir = "  + capture_dir  );
+                 " capture_dir = "  + capture_dir  + " pretrigger = " + std::to_string(pretrigger));
+    if (pretrigger >= chunksize) {
+        throw std::runtime_error("pretrigger must be smaller than chunksize");
+    }
 
-    d_start_capture = new boost::interprocess::mapped_region(boost::interprocess::anonymous_shared_memory(sizeof(int)));
     d_time_offset = time_offset;
     d_itemsize = itemsize;
     d_samp_rate = samp_rate;
@@ -82,23 +111,64 @@ capture_sink_impl::capture_sink_impl(size_t itemsize, size_t chunksize, size_t s
     strcpy(d_capture_dir,capture_dir);
     d_chunksize = chunksize;
     d_itemcount = 0;
-    d_current_capture_file = NULL;
-    d_capture_buffer = new gr_complex[chunksize];
-    memset(d_capture_buffer,0,sizeof(d_capture_buffer));
-    memset(d_start_capture->get_address(), 0, d_start_capture->get_size());
+    d_captured = 0;
+    d_pretrigger = pretrigger;
+    d_pretrigger_count = 0;
+    // Keep the last pretrigger samples around so a capture can start before its
+    // trigger. Even without pretrigger samples, a trigger from a branch that is
+    // behind us has to find its offset still in the ring.
+    d_history = new capture_ring(itemsize, pretrigger + TRIGGER_LAG_ITEMS);
+    d_trigger_pending = false;
+    d_trigger_offset = 0;
+    d_capture_start = 0;
+    d_capture_trigger = 0;
+    d_trigger_window = 0;
+    d_capture_trigger_window = 0;
+    d_next_trigger = false;
+    d_next_trigger_pending = false;
+    d_next_trigger_offset = 0;
+    d_next_trigger_window = 0;
+    d_sigmf = false;
+    d_capture_sigmf = false;
+    d_center_freq = 0;
+    d_format = FORMAT_FC32;
+    d_scale = 1;
+    d_store_itemsize = itemsize;
+    d_capture_format = FORMAT_FC32;
+    d_capture_scale = 1;
+    d_capture_store_itemsize = itemsize;
+    d_capture_buffer = NULL;
+    d_capture_control = 0;
+    // Double buffered. Buffers are allocated by the first captures that need
+    // them, sized for the file mode in use then: a streamed capture only ever
+    // holds segments, however long the capture.
+    d_nbuffers = 2;
+    d_allocated_buffers = 0;
+    d_buffer_bytes = 0;
+    d_peak_buffer_bytes = 0;
+    d_drop_policy = DROP_NEWEST;
+    d_dropped = 0;
+    d_file_mode = FILE_WRITE;
+    d_capture_mode = FILE_WRITE;
+    d_capture_fd = -1;
+    d_segment_items = 65536;
+    d_capture_segment = 0;
+    d_stream_fd = -1;
+    d_buffer_size = chunksize * itemsize;
+    d_capture_buffer_size = d_buffer_size;
+    d_writer_thread = NULL;
+    d_writer_done = false;
     d_event_url = new char[strlen(event_url) + 1];
     strcpy(d_event_url,event_url);
-    std::string errmsg;
-    try {
-        if (!d_mongo_client.connect(std::string("127.0.0.1:") + std::to_string(mongodb_port) ,errmsg)) {
-            GR_LOG_ERROR(d_debug_logger,"failed to initialize the client driver");
-            throw std::runtime_error("cannot connect to Mongo Client");
-        }
-        GR_LOG_DEBUG(d_debug_logger,"capture_sink_impl:: connected to mongod ");
-    } catch (std::exception& e) {
-        GR_LOG_ERROR(d_debug_logger,"Unexpected exception");
-        throw e;
-    }
+    d_publisher = new event_publisher(d_event_url);
+    d_outbox = NULL;
+    d_max_events = 1;
+    d_mongodb_port = mongodb_port;
+    d_metadata_acknowledged = true;
+    // mongod need not be up yet; the metadata writer connects when it has records.
+    d_metadata = metadata_writer::get(mongodb_port > 0 ? metadata_writer::BACKEND_MONGO
+                                                       : metadata_writer::BACKEND_NONE,
+                                      std::to_string(mongodb_port));
     message_port_register_in(pmt::mp("capture"));
     set_msg_handler(pmt::mp("capture"),boost::bind(&gr::msod_sensor::capture_sink_impl::message_handler,this, _1));
 }
@@ -108,41 +178,80 @@ capture_sink_impl::capture_sink_impl(size_t itemsize, size_t chunksize, size_t s
  */
 capture_sink_impl::~capture_sink_impl()
 {
+    stop();
+    delete d_publisher;
+    delete d_outbox;
+    delete d_history;
+    if (d_capture_fd >= 0) {
+        // A capture that never completed.
+        capture_job job;
+        job.buffer = d_capture_buffer;
+        job.fd = d_capture_fd;
+        job.file = d_capture_file;
+        discard_capture_file(job);
+    } else if (d_capture_buffer != NULL) {
+        free_buffer(d_capture_buffer, d_capture_buffer_size);
+    }
+    for (size_t i = 0; i < d_free_buffers.size(); i++) {
+        free_buffer(d_free_buffers[i], d_buffer_size);
+    }
+}
 
+bool
+capture_sink_impl::start() {
+    gr::thread::scoped_lock guard(d_mutex);
+    if (d_writer_thread == NULL) {
+        d_writer_done = false;
+        d_writer_thread = new gr::thread::thread(boost::bind(&capture_sink_impl::run_writer, this));
+    }
+    return true;
+}
+
+bool
+capture_sink_impl::stop() {
+    // Most of a streamed capture is already on disk; finish it with what we have.
+    if (d_capture_buffer != NULL && d_capture_mode == FILE_STREAM) {
+        d_start_capture.clear();
+        queue_buffer(true);
+        clear_buffer();
+    }
+    {
+        gr::thread::scoped_lock guard(d_mutex);
+        if (d_writer_thread == NULL) {
+            return true;
+        }
+        d_writer_done = true;
+        d_cond.notify_all();
+    }
+    // The writer drains whatever is still queued before it exits.
+    d_writer_thread->join();
+    delete d_writer_thread;
+    d_writer_thread = NULL;
+    // Give the records of the last captures a moment to reach mongod.
+    if (!d_metadata->flush(5.0)) {
+        GR_LOG_ERROR(d_debug_logger,"capture_sink_impl::stop: capture records still queued: " + d_metadata->last_error());
+    }
+    return true;
 }
 
 /*
 * Generate a file name (timestamped).
 */
-time_t capture_sink_impl::generate_timestamp() {
-    GR_LOG_DEBUG(d_debug_logger,"capture_sink_impl::generate_timestamp ");
-    struct timeval tp;
-    gettimeofday(&tp, NULL);
-    time_t  timev = tp.tv_sec;
-    std::string* dirname = new std::string(d_capture_dir);
-    dirname->append("/capture-");
-    std::string time_stamp = std::to_string(timev);
-    dirname->append(time_stamp);
+std::string capture_sink_impl::capture_file_name(time_t timev, const std::string& suffix) {
+    GR_LOG_DEBUG(d_debug_logger,"capture_sink_impl::capture_file_name ");
+    std::string dirname(d_capture_dir);
+    dirname.append("/capture-");
+    dirname.append(std::to_string(timev));
     struct stat statbuf;
-    if ( stat(dirname->c_str(),&statbuf) != -1 ) {
+    if ( stat((dirname + suffix).c_str(),&statbuf) != -1 ) {
         for (int counter = 1 ; counter < 1000; counter++) {
-            std::string* temp_dirname = new  std::string(*dirname);
-            temp_dirname->append(".");
-            temp_dirname->append(std::to_string(counter));
-            if ( stat(temp_dirname->c_str(),&statbuf) == -1 ) {
-                delete dirname;
-                dirname = temp_dirname;
-                break;
-            } else {
-                delete temp_dirname;
+            std::string temp_dirname = dirname + "." + std::to_string(counter);
+            if ( stat((temp_dirname + suffix).c_str(),&statbuf) == -1 ) {
+                return temp_dirname + suffix;
             }
         }
     }
-    if ( d_current_capture_file != NULL) {
-        delete d_current_capture_file;
-    }
-    d_current_capture_file =  dirname;
-    return timev;
+    return dirname + suffix;
 }
 
 void
@@ -150,8 +259,37 @@ capture_sink_impl::message_handler(pmt::pmt_t msg) {
 #ifdef IQCAPTURE_DEBUG
     GR_LOG_DEBUG(d_debug_logger,"capture_sink_impl::capture ");
 #endif
-    //Write all the memory to 1
-    memset(d_start_capture->get_address(), 1, sizeof(int));
+    // Messages are handled on the block thread, between calls to work().
+    // Triggers that say which sample they fired on start the capture there.
+    bool pending = false;
+    uint64_t offset = 0;
+    long window = 0;
+    if (pmt::is_dict(msg)) {
+        pmt::pmt_t value = pmt::dict_ref(msg, pmt::mp("offset"), pmt::PMT_NIL);
+        if (pmt::is_uint64(value)) {
+            offset = pmt::to_uint64(value);
+            pending = true;
+        }
+        value = pmt::dict_ref(msg, pmt::mp("window"), pmt::PMT_NIL);
+        if (pmt::is_integer(value)) {
+            window = pmt::to_long(value);
+        }
+    }
+    if (d_capture_buffer != NULL) {
+        // A capture is running. The first trigger that comes in meanwhile
+        // starts the next capture once this one is complete.
+        if (!d_next_trigger) {
+            d_next_trigger = true;
+            d_next_trigger_pending = pending;
+            d_next_trigger_offset = offset;
+            d_next_trigger_window = window;
+        }
+    } else {
+        d_trigger_pending = pending;
+        d_trigger_offset = offset;
+        d_trigger_window = window;
+    }
+    d_start_capture.set();
 }
 
 /**
@@ -163,7 +301,7 @@ capture_sink_impl::start_capture() {
 #ifdef IQCAPTURE_DEBUG
     GR_LOG_DEBUG(d_debug_logger,"capture_sink_impl::start_capture ");
 #endif
-    memset(d_start_capture->get_address(), 1, sizeof(int));
+    d_start_capture.set();
 }
 
 void
@@ -171,12 +309,172 @@ capture_sink_impl::stop_capture() {
 #ifdef IQCAPTURE_DEBUG
     GR_LOG_DEBUG(d_debug_logger,"capture_sink_impl::stop_capture ");
 #endif
-    memset(d_start_capture->get_address(), 0, sizeof(int));
+    d_start_capture.clear();
+}
+
+
+void
+capture_sink_impl::set_writer_policy(int nbuffers, int drop_policy) {
+    gr::thread::scoped_lock guard(d_mutex);
+    d_nbuffers = std::max(1, nbuffers);
+    d_drop_policy = drop_policy == DROP_OLDEST ? DROP_OLDEST : DROP_NEWEST;
+}
+
+int
+capture_sink_impl::queue_depth() {
+    gr::thread::scoped_lock guard(d_mutex);
+    return d_pending.size();
+}
+
+int
+capture_sink_impl::dropped_captures() {
+    gr::thread::scoped_lock guard(d_mutex);
+    return d_dropped;
+}
+
+size_t
+capture_sink_impl::peak_buffer_bytes() {
+    gr::thread::scoped_lock guard(d_mutex);
+    return d_peak_buffer_bytes;
+}
+
+void
+capture_sink_impl::set_file_mode(int mode) {
+    gr::thread::scoped_lock guard(d_mutex);
+    // Takes effect with the next capture.
+    d_file_mode = mode == FILE_MMAP || mode == FILE_STREAM ? mode : FILE_WRITE;
+    reset_pool();
+}
+
+void
+capture_sink_impl::set_segment_size(size_t nitems) {
+    gr::thread::scoped_lock guard(d_mutex);
+    d_segment_items = std::max((size_t) 1, nitems);
+    reset_pool();
 }
 
+void
+capture_sink_impl::reset_pool() {
+    size_t nitems = d_file_mode == FILE_STREAM ? std::min(d_segment_items, d_chunksize) : d_chunksize;
+    size_t nbytes = nitems * d_store_itemsize;
+    if (nbytes == d_buffer_size) {
+        return;
+    }
+    // Idle buffers have the old size. Buffers still queued are freed when they come back.
+    for (size_t i = 0; i < d_free_buffers.size(); i++) {
+        free_buffer(d_free_buffers[i], d_buffer_size);
+    }
+    d_free_buffers.clear();
+    d_buffer_size = nbytes;
+}
+
+char*
+capture_sink_impl::alloc_buffer(size_t nbytes) {
+    char* buffer = (char*) volk_malloc(nbytes, volk_get_alignment());
+    if (buffer == NULL) {
+        GR_LOG_ERROR(d_debug_logger,"capture_sink_impl::alloc_buffer: cannot allocate " + std::to_string(nbytes) + " bytes");
+        return NULL;
+    }
+    d_allocated_buffers++;
+    d_buffer_bytes += nbytes;
+    d_peak_buffer_bytes = std::max(d_peak_buffer_bytes, d_buffer_bytes);
+    return buffer;
+}
+
+void
+capture_sink_impl::free_buffer(char* buffer, size_t nbytes) {
+    volk_free(buffer);
+    d_allocated_buffers--;
+    d_buffer_bytes -= nbytes;
+}
+
+void
+capture_sink_impl::set_sigmf_output(bool enable) {
+    gr::thread::scoped_lock guard(d_mutex);
+    d_sigmf = enable;
+}
+
+void
+capture_sink_impl::set_center_freq(double freq) {
+    gr::thread::scoped_lock guard(d_mutex);
+    d_center_freq = freq;
+}
+
+void
+capture_sink_impl::set_storage_format(int format, float scale) {
+    if (format != FORMAT_FC32 && d_itemsize % sizeof(float) != 0) {
+        throw std::runtime_error("integer storage formats need float or complex items");
+    }
+    gr::thread::scoped_lock guard(d_mutex);
+    switch (format) {
+    case FORMAT_SC16:
+        d_format = FORMAT_SC16;
+        d_scale = scale != 0 ? scale : 32767;
+        d_store_itemsize = d_itemsize / sizeof(float) * sizeof(int16_t);
+        break;
+    case FORMAT_SC8:
+        d_format = FORMAT_SC8;
+        d_scale = scale != 0 ? scale : 127;
+        d_store_itemsize = d_itemsize / sizeof(float) * sizeof(int8_t);
+        break;
+    default:
+        d_format = FORMAT_FC32;
+        d_scale = 1;
+        d_store_itemsize = d_itemsize;
+    }
+    reset_pool();
+}
+
+void
+capture_sink_impl::set_event_batching(int max_events) {
+    gr::thread::scoped_lock guard(d_mutex);
+    d_max_events = std::max(1, max_events);
+    if (d_outbox != NULL) {
+        d_outbox->set_max_batch(d_max_events);
+    }
+}
+
+void
+capture_sink_impl::set_event_outbox(char* path, double min_backoff, double max_backoff) {
+    gr::thread::scoped_lock guard(d_mutex);
+    if (d_outbox != NULL) {
+        throw std::runtime_error("event outbox already set");
+    }
+    event_outbox* outbox = new event_outbox(path, d_event_url);
+    if (!outbox->is_open()) {
+        delete outbox;
+        throw std::runtime_error(std::string("cannot open event outbox ") + path);
+    }
+    outbox->set_max_batch(d_max_events);
+    outbox->set_backoff(min_backoff, max_backoff);
+    d_outbox = outbox;
+}
+
+int
+capture_sink_impl::pending_events() {
+    gr::thread::scoped_lock guard(d_mutex);
+    return d_outbox != NULL ? d_outbox->pending() : 0;
+}
+
+void
+capture_sink_impl::set_metadata_backend(int backend, char* path) {
+    std::string target = backend == metadata_writer::BACKEND_MONGO ? std::to_string(d_mongodb_port) : std::string(path);
+    metadata_writer::sptr metadata = metadata_writer::get(backend, target);
+    gr::thread::scoped_lock guard(d_mutex);
+    metadata->set_acknowledged(d_metadata_acknowledged);
+    d_metadata = metadata;
+}
+
+void
+capture_sink_impl::set_metadata_acknowledged(bool acknowledged) {
+    gr::thread::scoped_lock guard(d_mutex);
+    d_metadata_acknowledged = acknowledged;
+    d_metadata->set_acknowledged(acknowledged);
+}
 
 void
 capture_sink_impl::set_event_message(char* event_message) {
+    gr::thread::scoped_lock guard(d_mutex);
     try {
         d_event_message = mongo::fromjson(std::string(event_message));
         // The "t" field is updated later when the message is POSTed.
@@ -193,24 +491,54 @@ capture_sink_impl::set_event_message(char* event_message) {
 */
 
 bool
-capture_sink_impl::dump_buffer() {
-    int buffercounter = 0;
-    time_t ts = generate_timestamp();
-    GR_LOG_ERROR(d_debug_logger,"capture_sink_impl::dump_buffer: logging to  : " + *d_current_capture_file );
-    assert(d_itemcount == d_chunksize);
-    int fd = open(d_current_capture_file->c_str(), O_RDWR | O_CREAT, S_IWUSR | S_IRUSR);
-    if (fd < 0 ) {
-        GR_LOG_ERROR(d_debug_logger,"capture_sink_impl::dump_buffer: open failed on : " + *d_current_capture_file->c_str());
-        return false;
-    }
-    size_t written = write(fd,d_capture_buffer,d_chunksize*sizeof(gr_complex));
-    close(fd);
-    GR_LOG_DEBUG(d_debug_logger,"capture_sink_impl::dump_buffer: wrote " + std::to_string(written) + " elements to file : " + *d_current_capture_file);
-    time_t universal_timestamp = ts + d_time_offset;
+capture_sink_impl::dump_buffer(const capture_job& job) {
+    // Times are those of the samples, corrected by the configured offset.
+    int64_t offset_ns = (int64_t) d_time_offset * 1000000000LL;
+    int64_t start_ns = job.start_ns + offset_ns;
+    int64_t trigger_ns = job.trigger_ns + offset_ns;
+    time_t universal_timestamp = start_ns / 1000000000LL;
+    std::string capture_file;
+    if (job.streamed) {
+        capture_file = job.file;
+        bool ok = write_segment(job);
+        // The event goes out once the last segment is on disk.
+        if (!job.final || !ok) {
+            return ok;
+        }
+    } else if (job.fd >= 0) {
+        // The samples are already in the mapped file.
+        capture_file = job.file;
+        if (!close_capture_file(job)) {
+            return false;
+        }
+    } else {
+        capture_file = capture_file_name(job.start_ns / 1000000000LL, job.sigmf ? ".sigmf-data" : "");
+        GR_LOG_ERROR(d_debug_logger,"capture_sink_impl::dump_buffer: logging to  : " + capture_file );
+        int fd = open(capture_file.c_str(), O_RDWR | O_CREAT, S_IWUSR | S_IRUSR);
+        if (fd < 0 ) {
+            GR_LOG_ERROR(d_debug_logger,"capture_sink_impl::dump_buffer: open failed on : " + capture_file);
+            return false;
+        }
+        size_t nbytes = job.itemcount * job.store_itemsize;
+        bool ok = write_all(fd, job.buffer, nbytes);
+        // close() is where NFS and friends report a failed write.
+        if (close(fd) != 0) {
+            ok = false;
+        }
+        if (!ok) {
+            // No event or record for a file that does not hold the capture.
+            GR_LOG_ERROR(d_debug_logger,"capture_sink_impl::dump_buffer: write failed on : " + capture_file + " : " + strerror(errno));
+            return false;
+        }
+        GR_LOG_DEBUG(d_debug_logger,"capture_sink_impl::dump_buffer: wrote " + std::to_string(nbytes) + " bytes to file : " + capture_file);
+    }
+    if (job.sigmf && !write_sigmf_meta(job, capture_file, start_ns)) {
+        GR_LOG_ERROR(d_debug_logger,"capture_sink_impl::dump_buffer: cannot write SigMF metadata for : " + capture_file);
+    }
     mongo::BSONObjBuilder builder;
-    builder.appendElements(d_event_message);
+    builder.appendElements(job.event_message);
     mongo::BSONObj event_message = builder.appendNumber("t",(long long) universal_timestamp)
-                                   .appendNumber("SampleCount",(long long) d_itemcount)
+                                   .appendNumber("SampleCount",(long long) job.total_count)
                                    .obj();
 
 
@@ -218,55 +546,430 @@ capture_sink_impl::dump_buffer() {
     GR_LOG_DEBUG(d_debug_logger,"capture_sink_impl::event_message " + event_message.toString());
 #endif
     // Send a message to MSOD indicating capture event.
-    CURL *curl;
-    // get a curl handle
-    curl = curl_easy_init();
-    if(curl) {
-        GR_LOG_DEBUG(d_debug_logger,"capture_sink_imp:: POSTING to d_event_url : " + std::string(d_event_url))
-        GR_LOG_DEBUG(d_debug_logger,"capture_sink_imp:: event_url body : " + event_message.jsonString())
-        char* message_body = new char[strlen(event_message.jsonString().c_str()) + 1];
-        strcpy(message_body,event_message.jsonString().c_str());
-        struct curl_slist *slist=NULL;
-        slist = curl_slist_append(slist, "Content-Type: application/json");
-        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, slist);
-        curl_easy_setopt(curl, CURLOPT_POST, 1);
-        curl_easy_setopt(curl, CURLOPT_URL, d_event_url);
-        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, message_body);
-        curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, (long)strlen(event_message.jsonString().c_str()));
-        curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L); // TODO -- enable this check after official cert is installed.
-        curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 0L); // TODO -- make this 2L for strict check after official cert installed.
-        CURLcode res = curl_easy_perform(curl);
-        if(res != CURLE_OK) {
-            GR_LOG_ERROR(d_debug_logger,"Curl POST not successful : " + std::string(curl_easy_strerror(res)));
-        }
-        delete message_body;
-        curl_easy_cleanup(curl);
+    std::string message_body = event_message.jsonString();
+    GR_LOG_DEBUG(d_debug_logger,"capture_sink_imp:: POSTING to d_event_url : " + std::string(d_event_url))
+    GR_LOG_DEBUG(d_debug_logger,"capture_sink_imp:: event_url body : " + message_body)
+    event_outbox* outbox;
+    {
+        gr::thread::scoped_lock guard(d_mutex);
+        outbox = d_outbox;
+    }
+    if (outbox != NULL && outbox->append(message_body)) {
+        // The outbox's sender thread takes it from here.
     } else {
-        GR_LOG_ERROR(d_debug_logger,"Curl initialization not successful");
-        return false;
+        if (outbox != NULL) {
+            GR_LOG_ERROR(d_debug_logger,"capture_sink_impl::dump_buffer: cannot append to event outbox, posting directly");
+        }
+        if (!d_publisher->publish(message_body)) {
+            GR_LOG_ERROR(d_debug_logger,"Curl POST not successful : " + d_publisher->last_error());
+        }
     }
 
     // insert the message into the local database.
     mongo::BSONObjBuilder builder1;
-    builder1.appendElements(d_event_message);
+    builder1.appendElements(job.event_message);
     // Add the file name here -- it is not relevant to the server.
-    event_message = builder1.append("_capture_file",*d_current_capture_file)
+    event_message = builder1.append("_capture_file",capture_file)
                     .appendNumber("t",(long long) universal_timestamp)
-                    .appendNumber("SampleCount",(long long) d_itemcount)
+                    .appendNumber("SampleCount",(long long) job.total_count)
+                    .appendNumber("_pretrigger_count",(long long) job.pretrigger_count)
+                    .appendNumber("_start_sample",(long long) job.start_sample)
+                    .appendNumber("_trigger_sample",(long long) job.trigger_sample)
+                    .appendNumber("_start_time_ns",(long long) start_ns)
+                    .appendNumber("_trigger_time_ns",(long long) trigger_ns)
+                    .appendNumber("_completed_time_ns",(long long) job.completed.tv_sec * 1000000000LL + job.completed.tv_usec * 1000LL + offset_ns)
+                    .append("_time_source",job.device_time ? "rx_time" : "host")
+                    .append("_format",sigmf_datatype(job.format))
+                    .appendNumber("_scale",(double) job.scale)
                     .obj();
 
 
-    try {
-        d_mongo_client.insert("iqcapture.dataMessages",event_message);
-    } catch (mongo::DBException& e) {
-        GR_LOG_ERROR(d_debug_logger,"capture_sink_impl::Error inserting into mongodb ");
-        return false;
+    // Queued; the metadata writer inserts it in the background.
+    metadata_writer::sptr metadata;
+    {
+        gr::thread::scoped_lock guard(d_mutex);
+        metadata = d_metadata;
     }
-
-    clear_buffer();
+    metadata->insert("iqcapture.dataMessages",event_message);
     return true;
 }
 
+std::string
+capture_sink_impl::sigmf_datatype(int format) {
+    std::string kind = d_itemsize == sizeof(gr_complex) ? "c" : "r";
+    switch (format) {
+    case FORMAT_SC16:
+        return kind + "i16_le";
+    case FORMAT_SC8:
+        return kind + "i8";
+    default:
+        break;
+    }
+    switch (d_itemsize) {
+    case sizeof(gr_complex):
+        return "cf32_le";
+    case sizeof(float):
+        return "rf32_le";
+    case sizeof(short):
+        return "ri16_le";
+    default:
+        return "ri8";
+    }
+}
+
+/**
+* Write the SigMF metadata for a capture next to its .sigmf-data file.
+*/
+bool
+capture_sink_impl::write_sigmf_meta(const capture_job& job, const std::string& data_file, int64_t start_ns) {
+    double freq = job.center_freq;
+    if (freq == 0) {
+        mongo::BSONObj mpar = job.event_message.getObjectField("mPar");
+        if (mpar["fStart"].isNumber() && mpar["fStop"].isNumber()) {
+            freq = (mpar["fStart"].numberDouble() + mpar["fStop"].numberDouble()) / 2;
+        }
+    }
+    time_t secs = start_ns / 1000000000LL;
+    struct tm utc;
+    gmtime_r(&secs, &utc);
+    char datetime[32];
+    strftime(datetime, sizeof(datetime), "%Y-%m-%dT%H:%M:%S", &utc);
+
+    std::ostringstream meta;
+    meta << std::setprecision(15);
+    meta << "{\n  \"global\": {\n"
+         << "    \"core:datatype\": \"" << sigmf_datatype(job.format) << "\",\n"
+         << "    \"core:sample_rate\": " << d_samp_rate << ",\n"
+         << "    \"core:version\": \"1.0.0\",\n"
+         << "    \"core:recorder\": \"gr-msod_sensor capture_sink\",\n"
+         << "    \"msod_sensor:scale\": " << job.scale << ",\n"
+         << "    \"core:extensions\": [{\"name\": \"msod_sensor\", \"version\": \"1.0.0\", \"optional\": true}],\n"
+         << "    \"msod_sensor:event\": " << (job.event_message.isEmpty() ? "{}" : job.event_message.jsonString()) << "\n"
+         << "  },\n  \"captures\": [{\n"
+         << "    \"core:sample_start\": 0,\n"
+         << "    \"core:global_index\": " << job.start_sample << ",\n";
+    if (freq != 0) {
+        meta << "    \"core:frequency\": " << freq << ",\n";
+    }
+    meta << "    \"core:datetime\": \"" << datetime << "." << std::setw(9) << std::setfill('0')
+         << start_ns % 1000000000LL << std::setfill(' ') << "Z\"\n"
+         << "  }],\n  \"annotations\": [{\n"
+         << "    \"core:sample_start\": " << job.pretrigger_count << ",\n";
+    if (job.trigger_window > 0) {
+        meta << "    \"core:sample_count\": " << job.trigger_window << ",\n";
+    }
+    meta << "    \"core:label\": \"trigger\"\n  }]\n}\n";
+
+    // capture-<time>.sigmf-data -> capture-<time>.sigmf-meta
+    std::string meta_file = data_file.substr(0, data_file.size() - strlen("data")) + "meta";
+    std::ofstream out(meta_file.c_str());
+    out << meta.str();
+    out.close();
+    return !out.fail();
+}
+
+/**
+* Get a buffer for a capture that is about to start. Buffers are allocated on demand
+* up to d_nbuffers and recycled after the writer is done with them. When none is free
+* the drop policy decides which capture is lost.
+*/
+char*
+capture_sink_impl::acquire_buffer() {
+    gr::thread::scoped_lock guard(d_mutex);
+    // Pooled buffers fit the current settings; this capture may have started just before a change.
+    if (!d_free_buffers.empty() && d_buffer_size == d_capture_buffer_size) {
+        char* buffer = d_free_buffers.back();
+        d_free_buffers.pop_back();
+        return buffer;
+    }
+    if (d_allocated_buffers < d_nbuffers) {
+        char* buffer = alloc_buffer(d_capture_buffer_size);
+        if (buffer == NULL) {
+            d_dropped++;
+        }
+        return buffer;
+    }
+    d_dropped++;
+    // The writer always works on the front of the queue, so anything behind it is fair game,
+    // except for segments of a streamed capture, which must all reach the file.
+    if (d_drop_policy == DROP_OLDEST && d_pending.size() > 1 && !d_pending[1].streamed) {
+        capture_job oldest = d_pending[1];
+        d_pending.erase(d_pending.begin() + 1);
+        GR_LOG_ERROR(d_debug_logger,"capture_sink_impl::acquire_buffer: writer busy, dropped oldest queued capture");
+        if (oldest.fd < 0 && oldest.buffer_size == d_capture_buffer_size) {
+            return oldest.buffer;
+        }
+        // A mapped capture, or one from before the settings changed; it cannot be reused.
+        drop_job(oldest);
+        return alloc_buffer(d_capture_buffer_size);
+    }
+    GR_LOG_ERROR(d_debug_logger,"capture_sink_impl::acquire_buffer: writer busy, dropped capture");
+    return NULL;
+}
+
+/**
+* Create the file for a capture that is about to start, reserve its full size on
+* disk and map it, so work() copies the samples straight into the page cache.
+* Returns NULL when the capture has to be dropped.
+*/
+char*
+capture_sink_impl::map_capture_file(uint64_t start_sample) {
+    {
+        gr::thread::scoped_lock guard(d_mutex);
+        // Every capture in flight holds a mapping; nbuffers bounds how many.
+        if ((int) d_pending.size() + 1 > d_nbuffers) {
+            d_dropped++;
+            if (d_drop_policy == DROP_OLDEST && d_pending.size() > 1 && !d_pending[1].streamed) {
+                capture_job oldest = d_pending[1];
+                d_pending.erase(d_pending.begin() + 1);
+                drop_job(oldest);
+                GR_LOG_ERROR(d_debug_logger,"capture_sink_impl::map_capture_file: writer busy, dropped oldest queued capture");
+            } else {
+                GR_LOG_ERROR(d_debug_logger,"capture_sink_impl::map_capture_file: writer busy, dropped capture");
+                return NULL;
+            }
+        }
+    }
+    std::string file = capture_file_name(d_clock.time_ns(start_sample) / 1000000000LL, d_capture_sigmf ? ".sigmf-data" : "");
+    int fd = open(file.c_str(), O_RDWR | O_CREAT | O_EXCL, S_IWUSR | S_IRUSR);
+    if (fd < 0) {
+        GR_LOG_ERROR(d_debug_logger,"capture_sink_impl::map_capture_file: open failed on : " + file);
+        return NULL;
+    }
+    size_t nbytes = d_chunksize * d_capture_store_itemsize;
+    // Allocate the blocks up front: no block allocation while the samples
+    // stream in, and a full disk shows up here rather than as SIGBUS later.
+    int err = posix_fallocate(fd, 0, nbytes);
+    void* buffer = MAP_FAILED;
+    if (err == 0) {
+        buffer = mmap(NULL, nbytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    if (buffer == MAP_FAILED) {
+        GR_LOG_ERROR(d_debug_logger,"capture_sink_impl::map_capture_file: cannot allocate or map : " + file);
+        close(fd);
+        unlink(file.c_str());
+        return NULL;
+    }
+    madvise(buffer, nbytes, MADV_SEQUENTIAL);
+    d_capture_fd = fd;
+    d_capture_file = file;
+    return (char*) buffer;
+}
+
+/**
+* Flush a mapped capture to disk and release it. Called from the writer thread.
+*/
+bool
+capture_sink_impl::close_capture_file(const capture_job& job) {
+    size_t nbytes = d_chunksize * job.store_itemsize;
+    bool ok = msync(job.buffer, job.itemcount * job.store_itemsize, MS_SYNC) == 0;
+    munmap(job.buffer, nbytes);
+    // A capture cut short (history only) does not fill the preallocated size.
+    if (job.itemcount < d_chunksize && ftruncate(job.fd, job.itemcount * job.store_itemsize) != 0) {
+        ok = false;
+    }
+    close(job.fd);
+    if (!ok) {
+        GR_LOG_ERROR(d_debug_logger,"capture_sink_impl::close_capture_file: flush failed on : " + job.file);
+    }
+    GR_LOG_DEBUG(d_debug_logger,"capture_sink_impl::close_capture_file: wrote " + std::to_string(job.itemcount) + " elements to file : " + job.file);
+    return ok;
+}
+
+void
+capture_sink_impl::discard_capture_file(const capture_job& job) {
+    munmap(job.buffer, d_chunksize * job.store_itemsize);
+    close(job.fd);
+    unlink(job.file.c_str());
+}
+
+void
+capture_sink_impl::release_buffer(char* buffer, size_t nbytes) {
+    // Buffers sized for settings that are no longer current are not kept.
+    if (nbytes == d_buffer_size) {
+        d_free_buffers.push_back(buffer);
+    } else {
+        free_buffer(buffer, nbytes);
+    }
+}
+
+/**
+* Start a streamed capture: take its first segment buffer and create the file
+* that the writer thread appends the segments to.
+*/
+char*
+capture_sink_impl::start_stream(uint64_t start_sample) {
+    char* buffer = acquire_buffer();
+    if (buffer == NULL) {
+        return NULL;
+    }
+    std::string file = capture_file_name(d_clock.time_ns(start_sample) / 1000000000LL, d_capture_sigmf ? ".sigmf-data" : "");
+    int fd = open(file.c_str(), O_WRONLY | O_CREAT | O_EXCL, S_IWUSR | S_IRUSR);
+    if (fd < 0) {
+        GR_LOG_ERROR(d_debug_logger,"capture_sink_impl::start_stream: open failed on : " + file);
+        gr::thread::scoped_lock guard(d_mutex);
+        release_buffer(buffer, d_capture_buffer_size);
+        return NULL;
+    }
+    close(fd);
+    d_capture_file = file;
+    return buffer;
+}
+
+void
+capture_sink_impl::drop_job(const capture_job& job) {
+    if (job.fd >= 0) {
+        discard_capture_file(job);
+    } else if (job.buffer != NULL) {
+        free_buffer(job.buffer, job.buffer_size);
+    }
+}
+
+/**
+* Append a segment of a streamed capture to its file. Called from the writer
+* thread, which sees the segments of a capture in order.
+*/
+bool
+capture_sink_impl::write_segment(const capture_job& job) {
+    if (job.segment == 0) {
+        d_stream_fd = open(job.file.c_str(), O_WRONLY);
+        if (d_stream_fd < 0) {
+            GR_LOG_ERROR(d_debug_logger,"capture_sink_impl::write_segment: open failed on : " + job.file);
+        }
+    }
+    bool ok = d_stream_fd >= 0;
+    if (ok && job.buffer != NULL && !write_all(d_stream_fd, job.buffer, job.itemcount * job.store_itemsize)) {
+        GR_LOG_ERROR(d_debug_logger,"capture_sink_impl::write_segment: write failed on : " + job.file);
+        // The rest of the capture fails too, so it gets no event or record.
+        close(d_stream_fd);
+        d_stream_fd = -1;
+        ok = false;
+    }
+    if (job.final && d_stream_fd >= 0) {
+        if (close(d_stream_fd) != 0) {
+            GR_LOG_ERROR(d_debug_logger,"capture_sink_impl::write_segment: close failed on : " + job.file);
+            ok = false;
+        }
+        d_stream_fd = -1;
+    }
+    return ok;
+}
+
+/**
+* Hand the filled capture buffer to the writer thread.
+*/
+void
+capture_sink_impl::queue_buffer(bool final) {
+    capture_job job;
+    job.buffer = d_capture_buffer;
+    job.itemcount = d_itemcount;
+    job.total_count = d_captured;
+    job.buffer_size = d_capture_buffer_size;
+    job.streamed = d_capture_mode == FILE_STREAM;
+    job.segment = d_capture_segment;
+    job.final = final;
+    job.pretrigger_count = d_pretrigger_count;
+    job.start_sample = d_capture_start;
+    job.trigger_sample = d_capture_trigger;
+    job.start_ns = d_clock.time_ns(d_capture_start);
+    job.trigger_ns = d_clock.time_ns(d_capture_trigger);
+    job.device_time = d_clock.from_device();
+    job.fd = d_capture_fd;
+    job.file = d_capture_file;
+    d_capture_fd = -1;
+    job.sigmf = d_capture_sigmf;
+    job.trigger_window = d_capture_trigger_window;
+    job.format = d_capture_format;
+    job.scale = d_capture_scale;
+    job.store_itemsize = d_capture_store_itemsize;
+    gettimeofday(&job.completed, NULL);
+    gr::thread::scoped_lock guard(d_mutex);
+    job.event_message = d_event_message;
+    job.center_freq = d_center_freq;
+    d_pending.push_back(job);
+    d_cond.notify_one();
+    d_capture_buffer = NULL;
+}
+
+/**
+* Writer thread. Takes completed captures off the queue and dumps them.
+*/
+void
+capture_sink_impl::run_writer() {
+    gr::thread::scoped_lock guard(d_mutex);
+    while (true) {
+        while (d_pending.empty() && !d_writer_done) {
+            d_cond.wait(guard);
+        }
+        if (d_pending.empty()) {
+            guard.unlock();
+            flush_events();
+            return;
+        }
+        // The job stays at the front of the queue while it is written so that
+        // acquire_buffer() knows not to steal its buffer.
+        capture_job job = d_pending.front();
+        d_publisher->set_max_batch(d_max_events);
+        guard.unlock();
+        if (!dump_buffer(job)) {
+            GR_LOG_ERROR(d_debug_logger,"capture_sink_impl::run_writer: failed to write capture");
+        }
+        guard.lock();
+        d_pending.pop_front();
+        // Mapped captures were released by dump_buffer().
+        if (job.fd < 0 && job.buffer != NULL) {
+            release_buffer(job.buffer, job.buffer_size);
+        }
+        // End of a burst of captures: send any events still batched.
+        if (d_pending.empty() && d_publisher->batched() > 0) {
+            guard.unlock();
+            flush_events();
+            guard.lock();
+        }
+    }
+}
+
+
+void
+capture_sink_impl::store_items(const char* in, size_t nitems) {
+    size_t buffer_items = d_capture_buffer_size / d_capture_store_itemsize;
+    while (nitems > 0 && d_capture_buffer != NULL) {
+        size_t n = std::min(nitems, buffer_items - d_itemcount);
+        char* out = d_capture_buffer + d_itemcount * d_capture_store_itemsize;
+        size_t nfloats = n * d_itemsize / sizeof(float);
+        switch (d_capture_format) {
+        case FORMAT_SC16:
+            volk_32f_s32f_convert_16i((int16_t*) out, (const float*) in, d_capture_scale, nfloats);
+            break;
+        case FORMAT_SC8:
+            volk_32f_s32f_convert_8i((int8_t*) out, (const float*) in, d_capture_scale, nfloats);
+            break;
+        default:
+            memcpy(out, in, n * d_itemsize);
+        }
+        d_itemcount += n;
+        d_captured += n;
+        in += n * d_itemsize;
+        nitems -= n;
+        // A full segment of a streamed capture goes to the writer right away.
+        if (d_capture_mode == FILE_STREAM && d_itemcount == buffer_items && d_captured < d_chunksize) {
+            queue_buffer(false);
+            d_capture_segment++;
+            d_itemcount = 0;
+            d_capture_buffer = acquire_buffer();
+            if (d_capture_buffer == NULL) {
+                GR_LOG_ERROR(d_debug_logger,"capture_sink_impl::store_items: writer busy, capture cut short at " + std::to_string(d_captured) + " items");
+            }
+        }
+    }
+}
+
+void
+capture_sink_impl::flush_events() {
+    if (!d_publisher->flush()) {
+        GR_LOG_ERROR(d_debug_logger,"Curl POST not successful : " + d_publisher->last_error());
+    }
+}
 
 void
 capture_sink_impl::clear_buffer() {
@@ -282,32 +985,107 @@ capture_sink_impl::work(int noutput_items,
                         gr_vector_void_star &output_items)
 {
 
-    // Capture is enabled.
-    const gr_complex *input = (const gr_complex *) input_items[0];
-    // Capture is not enabled. Just pass through.
-    int start_capture_flag;
-    memcpy(&start_capture_flag,d_start_capture->get_address(),sizeof(int));
-    if (!start_capture_flag) return noutput_items;
-    unsigned int byte_size = noutput_items * d_itemsize;
+    const char *input = (const char *) input_items[0];
+    // One look at the flag per call; see control_flag.
+    uint32_t control = d_start_capture.load();
+    bool start_capture_flag = control_flag::is_set(control);
+    uint64_t nread = nitems_read(0);
+    // Keep the sample clock in step with the source's time tags.
+    std::vector<tag_t> tags;
+    get_tags_in_range(tags, 0, nread, nread + noutput_items);
+    d_clock.handle_tags(tags);
+    d_clock.anchor(nread + noutput_items);
+    // Where in this call's input the capture continues.
+    size_t input_start = 0;
+    bool history_only = false;
+    if (start_capture_flag && d_capture_buffer == NULL) {
+        // The trigger sample defaults to the first one of this call.
+        uint64_t trigger = d_trigger_pending ? d_trigger_offset : nread;
+        uint64_t capture_start = trigger > d_pretrigger ? trigger - d_pretrigger : 0;
+        if (capture_start >= nread + noutput_items) {
+            // The trigger came from a branch that is ahead of us. Wait for it.
+            start_capture_flag = false;
+        } else {
 #ifdef IQCAPTURE_DEBUG
-    GR_LOG_DEBUG(d_debug_logger,"capture_sink_impl::work byte_size " + std::to_string(byte_size));
-    GR_LOG_DEBUG(d_debug_logger,"capture_sink_impl::work noutput_items " + std::to_string(noutput_items));
+            GR_LOG_DEBUG(d_debug_logger,"capture_sink_impl::work starting capture");
 #endif
-    int buffercounter = 0;
-    for (int i = 0; i < noutput_items; i++ , input++) {
-        // Exceeded our storage capacity? So dump the buffer and clear it.
-        if (d_itemcount ==  d_chunksize && start_capture_flag) {
-            memset(d_start_capture->get_address(), 0, d_start_capture->get_size());
-            if (! dump_buffer() ) {
-                return -1;
+            d_capture_trigger_window = d_trigger_pending ? d_trigger_window : 0;
+            d_trigger_pending = false;
+            // New capture. Get a buffer for it or drop it if the writer is backed up.
+            int file_mode;
+            {
+                gr::thread::scoped_lock guard(d_mutex);
+                file_mode = d_file_mode;
+                d_capture_sigmf = d_sigmf;
+                d_capture_format = d_format;
+                d_capture_scale = d_scale;
+                d_capture_store_itemsize = d_store_itemsize;
+                d_capture_buffer_size = file_mode == FILE_MMAP ? d_chunksize * d_store_itemsize : d_buffer_size;
+            }
+            d_capture_mode = file_mode;
+            d_capture_control = control;
+            d_capture_segment = 0;
+            d_captured = 0;
+            switch (file_mode) {
+            case FILE_MMAP:
+                d_capture_buffer = map_capture_file(capture_start);
+                break;
+            case FILE_STREAM:
+                d_capture_buffer = start_stream(capture_start);
+                break;
+            default:
+                d_capture_buffer = acquire_buffer();
+            }
+            d_itemcount = 0;
+            d_pretrigger_count = 0;
+            if (d_capture_buffer == NULL) {
+                d_start_capture.clear_if(control);
+                start_capture_flag = false;
             } else {
-                return noutput_items;
+                uint64_t first = nread;
+                if (capture_start < nread) {
+                    // Seed the capture with whatever history we have from before
+                    // this call, starting at capture_start if it is still held.
+                    uint64_t end = std::min(nread, capture_start + d_chunksize);
+                    struct iovec iov[2];
+                    int count = d_history->regions(iov, end, end - capture_start);
+                    for (int i = 0; i < count; i++) {
+                        store_items((const char*) iov[i].iov_base, iov[i].iov_len / d_itemsize);
+                    }
+                    first = end - d_captured;
+                    // The whole capture lies in the past; don't append this call's input.
+                    history_only = end < nread;
+                } else if (capture_start > nread) {
+                    input_start = capture_start - nread;
+                    first = capture_start;
+                }
+                d_pretrigger_count = trigger > first ? trigger - first : 0;
+                d_capture_start = first;
+                d_capture_trigger = trigger;
+            }
+        }
+    }
+    if (start_capture_flag) {
+        size_t ncopy = history_only ? 0 : std::min((size_t) noutput_items - input_start, d_chunksize - d_captured);
+        store_items(input + input_start * d_itemsize, ncopy);
+        // Capture complete (or a stream cut short)? Hand it to the writer and carry on.
+        if (d_captured == d_chunksize || history_only || d_capture_buffer == NULL) {
+            // A start that came in during this capture begins the next one,
+            // at the sample its trigger named.
+            d_start_capture.clear_if(d_capture_control);
+            queue_buffer(true);
+            clear_buffer();
+            if (d_next_trigger) {
+                d_next_trigger = false;
+                d_trigger_pending = d_next_trigger_pending;
+                d_trigger_offset = d_next_trigger_offset;
+                d_trigger_window = d_next_trigger_window;
             }
         }
-        // Our queue is not yet full. Keep adding to it.
-        d_capture_buffer[d_itemcount] = *input;
-        d_itemcount++;
     }
+    // Keep the history current (also during a capture) so a new trigger
+    // right after this capture still sees contiguous pre-trigger samples.
+    d_history->write(input, noutput_items);
     return noutput_items;
 }
 
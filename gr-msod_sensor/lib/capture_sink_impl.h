@@ -27,13 +27,54 @@
 #include <pmt/pmt.h>
 #include <fstream>
 #include <vector>
-#include <boost/interprocess/anonymous_shared_memory.hpp>
-#include <boost/interprocess/mapped_region.hpp>
+#include <deque>
+#include <sys/time.h>
+#include <gnuradio/thread/thread.h>
+#include "capture_ring.h"
+#include "sample_clock.h"
+#include "event_publisher.h"
+#include "event_outbox.h"
+#include "metadata_writer.h"
+#include "control_flag.h"
 
 
 namespace gr {
   namespace msod_sensor {
 
+    // A filled capture buffer handed from work() to the writer thread.
+    struct capture_job
+    {
+      char*  buffer;
+      size_t itemcount;
+      size_t pretrigger_count;
+      // Absolute sample indices of the first captured sample and the trigger.
+      uint64_t start_sample;
+      uint64_t trigger_sample;
+      int64_t start_ns;
+      int64_t trigger_ns;
+      bool    device_time;
+      struct timeval completed;
+      mongo::BSONObj event_message;
+      // Open capture file that buffer maps (-1 when buffer is plain memory).
+      int    fd;
+      std::string file;
+      // SigMF recording: sidecar metadata plus the trigger window size.
+      bool   sigmf;
+      double center_freq;
+      long   trigger_window;
+      // Storage format of buffer, and its bytes per item.
+      int    format;
+      float  scale;
+      size_t store_itemsize;
+      size_t buffer_size;
+      // Streaming mode: buffer is segment number segment of the capture and
+      // holds itemcount items; total_count is the capture length so far.
+      bool   streamed;
+      size_t segment;
+      bool   final;
+      size_t total_count;
+    };
+
     class capture_sink_impl : public capture_sink
     {
      private:
@@ -44,19 +85,146 @@ namespace gr {
       char*  d_websocket_url; 
       size_t d_chunksize;
       size_t d_samp_rate;
+      // Items in the capture buffer, and in the whole capture (they differ
+      // only when streaming).
       long   d_itemcount;
-      boost::interprocess::mapped_region  * d_start_capture;
+      size_t d_captured;
+      // Pre-trigger history, plus room for triggers that lag behind us.
+      size_t d_pretrigger;
+      size_t d_pretrigger_count;
+      capture_ring* d_history;
+      // Absolute sample index carried by the last trigger message.
+      bool   d_trigger_pending;
+      uint64_t d_trigger_offset;
+      // Sample indices of the running capture.
+      uint64_t d_capture_start;
+      uint64_t d_capture_trigger;
+      // Window size reported by the trigger (0 if unknown).
+      long   d_trigger_window;
+      // A trigger that came in during a capture, for the next one.
+      bool   d_next_trigger;
+      bool   d_next_trigger_pending;
+      uint64_t d_next_trigger_offset;
+      long   d_next_trigger_window;
+      long   d_capture_trigger_window;
+      // Sample index to time, from rx_time tags or the host clock.
+      sample_clock d_clock;
+      // Set to start a capture, cleared once it is complete. Shared with
+      // forked processes that call start_capture().
+      control_flag d_start_capture;
+      // The flag as it was when the current capture started.
+      uint32_t d_capture_control;
       long   d_capture_freq;
-      gr_complex* d_capture_buffer;
+      char*  d_capture_buffer;
       char*  d_event_url;
       mongo::BSONObj d_event_message;
       std::ofstream d_logfile;
-      std::string* d_current_capture_file;
-      mongo::DBClientConnection d_mongo_client;
+      // Shared background inserter for the local capture records.
+      metadata_writer::sptr d_metadata;
+      int d_mongodb_port;
+      bool d_metadata_acknowledged;
+      // Keeps the connection to the event URL open between captures.
+      event_publisher* d_publisher;
+      // Durable queue for the events (NULL unless an outbox is set).
+      event_outbox* d_outbox;
+      int    d_max_events;
+
+      // Background writer. Filled buffers are queued in d_pending and
+      // written out (file, event POST, mongo record) off the scheduler thread.
+      enum drop_policy {DROP_NEWEST, DROP_OLDEST};
+      gr::thread::mutex d_mutex;
+      gr::thread::condition_variable d_cond;
+      gr::thread::thread* d_writer_thread;
+      bool   d_writer_done;
+      std::deque<capture_job> d_pending;
+      std::vector<char*> d_free_buffers;
+      int    d_nbuffers;
+      int    d_allocated_buffers;
+      // Bytes held by pooled buffers now, and the most ever held at once.
+      size_t d_buffer_bytes;
+      size_t d_peak_buffer_bytes;
+      int    d_drop_policy;
+      int    d_dropped;
+      // Bytes per pooled buffer for the current mode and format.
+      size_t d_buffer_size;
+      size_t d_capture_buffer_size;
+      // Mapped capture file of the running capture (FILE_MMAP mode), or the
+      // file being streamed to (FILE_STREAM mode).
+      enum file_mode {FILE_WRITE, FILE_MMAP, FILE_STREAM};
+      int    d_file_mode;
+      int    d_capture_mode;
+      int    d_capture_fd;
+      std::string d_capture_file;
+      size_t d_segment_items;
+      size_t d_capture_segment;
+      // Streamed file being written by the writer thread.
+      int    d_stream_fd;
+      // SigMF output settings, and whether the running capture uses it.
+      bool   d_sigmf;
+      bool   d_capture_sigmf;
+      double d_center_freq;
+      // On-disk sample format. The d_capture_ values are fixed when a capture starts.
+      enum storage_format {FORMAT_FC32, FORMAT_SC16, FORMAT_SC8};
+      int    d_format;
+      float  d_scale;
+      size_t d_store_itemsize;
+      int    d_capture_format;
+      float  d_capture_scale;
+      size_t d_capture_store_itemsize;
 	
-      time_t generate_timestamp();
+      std::string capture_file_name(time_t timev, const std::string& suffix);
+
+      // SigMF data type of the samples as stored.
+      std::string sigmf_datatype(int format);
+
+      // append nitems input items to the capture buffer in the storage format.
+      void store_items(const char* in, size_t nitems);
+
+      // write the .sigmf-meta sidecar of a capture.
+      bool write_sigmf_meta(const capture_job& job, const std::string& data_file, int64_t start_ns);
       // dump buffer
-      bool dump_buffer();
+      bool dump_buffer(const capture_job& job);
+
+      // get a buffer for a new capture (NULL if the capture has to be dropped).
+      char* acquire_buffer();
+
+      // aligned buffer allocation for the pool, counted in d_allocated_buffers
+      // (d_mutex held). alloc_buffer() returns NULL when out of memory.
+      char* alloc_buffer(size_t nbytes);
+      void free_buffer(char* buffer, size_t nbytes);
+
+      // resize the pool for the current mode and format (d_mutex held).
+      void reset_pool();
+
+      // release whatever a dropped capture holds (d_mutex held).
+      void drop_job(const capture_job& job);
+
+      // get the first buffer and create the file of a streamed capture.
+      char* start_stream(uint64_t start_sample);
+
+      // give a buffer back to the pool, or free it if it no longer fits.
+      void release_buffer(char* buffer, size_t nbytes);
+
+      // append one segment of a streamed capture to its file.
+      bool write_segment(const capture_job& job);
+
+      // create, preallocate and map the file for a new capture (FILE_MMAP mode).
+      char* map_capture_file(uint64_t start_sample);
+
+      // flush and unmap a mapped capture, trimming the file to itemcount items.
+      bool close_capture_file(const capture_job& job);
+
+      // throw away a mapped capture that was dropped.
+      void discard_capture_file(const capture_job& job);
+
+      // hand the filled buffer to the writer thread.
+      void queue_buffer(bool final);
+
+      // post any batched capture events (writer thread).
+      void flush_events();
+
+      // writer thread body.
+      void run_writer();
 	
       // clear the buffer.
       void clear_buffer();
@@ -66,12 +234,15 @@ namespace gr {
 
 
      public:
-      capture_sink_impl(size_t itemsize, size_t chunksize, size_t samp_rate, char* capture_dir, int mongodb_port, char* event_url, int time_offset);
+      capture_sink_impl(size_t itemsize, size_t chunksize, size_t samp_rate, char* capture_dir, int mongodb_port, char* event_url, int time_offset, size_t pretrigger);
       ~capture_sink_impl();
       // Where all the action really happens
       int work(int noutput_items,
          gr_vector_const_void_star &input_items,
          gr_vector_void_star &output_items);
+
+      bool start();
+      bool stop();
 	
       // set the sensor id (for posting to the database).
       void set_event_message(char* event_message);
@@ -81,6 +252,21 @@ namespace gr {
       // stop capture
       void stop_capture();
 
+      void set_writer_policy(int nbuffers, int drop_policy);
+      int queue_depth();
+      int dropped_captures();
+      size_t peak_buffer_bytes();
+      void set_file_mode(int mode);
+      void set_segment_size(size_t nitems);
+      void set_sigmf_output(bool enable);
+      void set_center_freq(double freq);
+      void set_storage_format(int format, float scale);
+      void set_event_batching(int max_events);
+      void set_event_outbox(char* path, double min_backoff, double max_backoff);
+      int pending_events();
+      void set_metadata_backend(int backend, char* path);
+      void set_metadata_acknowledged(bool acknowledged);
+
     };
       
 
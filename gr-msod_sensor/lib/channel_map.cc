@@ -0,0 +1,75 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <volk/volk.h>
+#include "channel_map.h"
+
+namespace gr {
+namespace msod_sensor {
+
+channel_map::channel_map(unsigned int nbins, unsigned int nchannels)
+    : d_nbins(nbins), d_nchannels(nchannels)
+{
+}
+
+void
+channel_map::set_index(const std::vector<unsigned int>& index, unsigned int rotate)
+{
+    d_ranges.clear();
+    for (unsigned int i = 0; i < d_nbins; i++) {
+        unsigned int j = (i + rotate) % d_nbins;
+        unsigned int channel = j < index.size() ? index[j] : 0;
+        if (channel == 0 || channel > d_nchannels) {
+            continue;
+        }
+        // Stored 0 based from here on.
+        channel--;
+        if (!d_ranges.empty() && d_ranges.back().channel == channel
+                && d_ranges.back().start + d_ranges.back().length == i) {
+            d_ranges.back().length++;
+        } else {
+            bin_range range = { i, 1, channel };
+            d_ranges.push_back(range);
+        }
+    }
+}
+
+void
+channel_map::accumulate(const float* bins, float* channels) const
+{
+    for (size_t r = 0; r < d_ranges.size(); r++) {
+        const bin_range& range = d_ranges[r];
+        if (range.length == 1) {
+            channels[range.channel] += bins[range.start];
+        } else {
+            float sum;
+            volk_32f_accumulator_s32f(&sum, bins + range.start, range.length);
+            channels[range.channel] += sum;
+        }
+    }
+}
+
+} /* namespace msod_sensor */
+} /* namespace gr */
@@ -0,0 +1,70 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef INCLUDED_MSOD_SENSOR_CHANNEL_MAP_H
+#define INCLUDED_MSOD_SENSOR_CHANNEL_MAP_H
+
+#include <vector>
+
+namespace gr {
+  namespace msod_sensor {
+
+    /*!
+     * Sums the FFT bins of a frame into channels.
+     *
+     * The bin to channel map (1 based, 0 for bins that belong to no
+     * channel) is mostly long runs of consecutive bins that go to the
+     * same channel. It is turned into (start, length, channel) runs once,
+     * so each frame only sums runs, with a VOLK reduction.
+     */
+    class channel_map
+    {
+     public:
+      channel_map(unsigned int nbins, unsigned int nchannels);
+
+      // Compile the map. Bin i of the frame takes the channel of
+      // index[(i + rotate) % nbins], which lets the caller work on an
+      // unshifted FFT with a map written for the shifted one. Bins mapped
+      // to 0 or past the last channel are left out.
+      void set_index(const std::vector<unsigned int>& index, unsigned int rotate=0);
+
+      // channels[c] += sum of the bins of channel c + 1.
+      void accumulate(const float* bins, float* channels) const;
+
+      unsigned int nbins() const { return d_nbins; }
+      unsigned int nchannels() const { return d_nchannels; }
+
+     private:
+      struct bin_range {
+        unsigned int start;
+        unsigned int length;
+        unsigned int channel;   // 0 based
+      };
+
+      unsigned int d_nbins;
+      unsigned int d_nchannels;
+      std::vector<bin_range> d_ranges;
+    };
+
+  } // namespace msod_sensor
+} // namespace gr
+
+#endif /* INCLUDED_MSOD_SENSOR_CHANNEL_MAP_H */
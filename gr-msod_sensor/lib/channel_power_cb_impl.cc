@@ -0,0 +1,159 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gnuradio/io_signature.h>
+#include <volk/volk.h>
+#include <algorithm>
+#include <stdexcept>
+#include <string.h>
+#include "channel_power_cb_impl.h"
+#include "power_db.h"
+
+namespace gr {
+namespace msod_sensor {
+
+channel_power_cb::sptr
+channel_power_cb::make(unsigned int fft_size, const std::vector<float> &window,
+                       unsigned int num_ch, const std::vector<unsigned int> &bin_index,
+                       unsigned int meas_interval, int det, float offset_db)
+{
+    return gnuradio::get_initial_sptr
+           (new channel_power_cb_impl(fft_size, window, num_ch, bin_index, meas_interval, det, offset_db));
+}
+
+channel_power_cb_impl::channel_power_cb_impl(unsigned int fft_size, const std::vector<float> &window,
+                                             unsigned int num_ch, const std::vector<unsigned int> &bin_index,
+                                             unsigned int meas_interval, int det, float offset_db)
+    : gr::block("channel_power_cb",
+                gr::io_signature::make(1, 1, sizeof(gr_complex)),
+                gr::io_signature::make(1, 1, num_ch * sizeof(int8_t))),
+    d_fft_size(fft_size), d_num_ch(num_ch), d_meas_interval(std::max(meas_interval, 1u)),
+    d_det(det), d_offset_db(offset_db), d_window(window),
+    d_map(fft_size, num_ch), d_frame_power(num_ch), d_acc(num_ch), d_dbm(num_ch)
+{
+    if (!window.empty() && window.size() != fft_size) {
+        throw std::invalid_argument("channel_power_cb: window length must match the FFT size");
+    }
+    d_fft = new gr::fft::fft_complex(fft_size, true);
+    d_power = (float*) volk_malloc(fft_size * sizeof(float), volk_get_alignment());
+    set_bin_index(bin_index);
+    set_relative_rate(1.0 / ((double) fft_size * d_meas_interval));
+}
+
+channel_power_cb_impl::~channel_power_cb_impl()
+{
+    volk_free(d_power);
+    delete d_fft;
+}
+
+void
+channel_power_cb_impl::set_bin_index(const std::vector<unsigned int> &bin_index)
+{
+    gr::thread::scoped_lock guard(d_mutex);
+    // fft_vcc shifts by moving bin ceil(N/2) to the front, so unshifted
+    // bin i is at floor(N/2) + i (mod N) in the shifted map.
+    d_map.set_index(bin_index, d_fft_size / 2);
+    // A measurement that straddles the change would mix two channel plans.
+    reset_measurement();
+}
+
+void
+channel_power_cb_impl::reset_measurement()
+{
+    std::fill(d_acc.begin(), d_acc.end(), 0);
+    d_frames = 0;
+}
+
+/*
+* Convert the finished measurement to dBm, rounded and clipped to int8
+* (what nlog10_ff followed by float_to_char did).
+*/
+void
+channel_power_cb_impl::emit(int8_t* out)
+{
+    const float scale = d_det == AVG ? 1 / static_cast<float>(d_meas_interval) : 1;
+    volk_32f_s32f_multiply_32f(&d_dbm[0], &d_acc[0], scale, d_num_ch);
+    power_to_db(&d_dbm[0], &d_dbm[0], d_num_ch, d_offset_db);
+    volk_32f_s32f_convert_8i(out, &d_dbm[0], 1.0, d_num_ch);
+}
+
+void
+channel_power_cb_impl::forecast (int noutput_items, gr_vector_int &ninput_items_required)
+{
+    // The measurement is accumulated across calls; one frame is enough to go on.
+    ninput_items_required[0] = d_fft_size;
+}
+
+int
+channel_power_cb_impl::general_work (int noutput_items,
+                                     gr_vector_int &ninput_items,
+                                     gr_vector_const_void_star &input_items,
+                                     gr_vector_void_star &output_items)
+{
+    const gr_complex *in = (const gr_complex *) input_items[0];
+    int8_t *out = (int8_t *) output_items[0];
+
+    gr::thread::scoped_lock guard(d_mutex);
+    int nframes = ninput_items[0] / d_fft_size;
+    int produced = 0;
+    int frame = 0;
+    for (; frame < nframes && produced < noutput_items; frame++) {
+        const gr_complex* x = in + frame * d_fft_size;
+        gr_complex* fft_in = d_fft->get_inbuf();
+        if (d_window.empty()) {
+            memcpy(fft_in, x, d_fft_size * sizeof(gr_complex));
+        } else {
+            volk_32fc_32f_multiply_32fc(fft_in, x, &d_window[0], d_fft_size);
+        }
+        d_fft->execute();
+        volk_32fc_magnitude_squared_32f(d_power, d_fft->get_outbuf(), d_fft_size);
+
+        if (d_det == AVG) {
+            // Summing every frame into the same channels is the average, up to 1/N.
+            d_map.accumulate(d_power, &d_acc[0]);
+        } else {
+            std::fill(d_frame_power.begin(), d_frame_power.end(), 0);
+            d_map.accumulate(d_power, &d_frame_power[0]);
+            if (d_frames == 0) {
+                d_acc = d_frame_power;
+            } else {
+                volk_32f_x2_max_32f(&d_acc[0], &d_acc[0], &d_frame_power[0], d_num_ch);
+            }
+        }
+
+        if (++d_frames == d_meas_interval) {
+            emit(out + produced * d_num_ch);
+            produced++;
+            reset_measurement();
+        }
+    }
+
+    consume_each(frame * d_fft_size);
+    return produced;
+}
+
+} /* namespace msod_sensor */
+} /* namespace gr */
+
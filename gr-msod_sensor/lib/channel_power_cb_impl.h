@@ -0,0 +1,80 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef INCLUDED_MSOD_SENSOR_CHANNEL_POWER_CB_IMPL_H
+#define INCLUDED_MSOD_SENSOR_CHANNEL_POWER_CB_IMPL_H
+
+#include <msod_sensor/channel_power_cb.h>
+#include <gnuradio/fft/fft.h>
+#include <gnuradio/thread/thread.h>
+#include "channel_map.h"
+
+namespace gr {
+  namespace msod_sensor {
+
+    class channel_power_cb_impl : public channel_power_cb
+    {
+     private:
+      enum Det {AVG, PEAK};
+      unsigned int d_fft_size;
+      unsigned int d_num_ch;
+      unsigned int d_meas_interval;
+      int d_det;
+      float d_offset_db;
+      std::vector<float> d_window;
+      // The plan is made once and reused for every frame.
+      gr::fft::fft_complex* d_fft;
+      // |X|^2 of the current frame (volk aligned).
+      float* d_power;
+      // Bin index of the shifted FFT, compiled for the unshifted one.
+      channel_map d_map;
+      // Channel power of the current frame (PEAK only).
+      std::vector<float> d_frame_power;
+      // Running sum (AVG) or max (PEAK) over the measurement so far.
+      std::vector<float> d_acc;
+      std::vector<float> d_dbm;
+      unsigned int d_frames;
+      gr::thread::mutex d_mutex;
+
+      void reset_measurement();
+      void emit(int8_t* out);
+
+     public:
+      channel_power_cb_impl(unsigned int fft_size, const std::vector<float> &window,
+                            unsigned int num_ch, const std::vector<unsigned int> &bin_index,
+                            unsigned int meas_interval, int det, float offset_db);
+      ~channel_power_cb_impl();
+
+      void set_bin_index(const std::vector<unsigned int> &bin_index);
+
+      void forecast (int noutput_items, gr_vector_int &ninput_items_required);
+
+      int general_work(int noutput_items,
+           gr_vector_int &ninput_items,
+           gr_vector_const_void_star &input_items,
+           gr_vector_void_star &output_items);
+    };
+
+  } // namespace msod_sensor
+} // namespace gr
+
+#endif /* INCLUDED_MSOD_SENSOR_CHANNEL_POWER_CB_IMPL_H */
+
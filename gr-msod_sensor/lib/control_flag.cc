@@ -0,0 +1,98 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <errno.h>
+#include <string.h>
+#include "control_flag.h"
+
+// A lock free atomic is address free, so it works across processes.
+static_assert(ATOMIC_INT_LOCK_FREE == 2, "control_flag needs a lock free std::atomic<uint32_t>");
+
+namespace gr {
+namespace msod_sensor {
+
+void*
+map_shared(size_t size)
+{
+    void* addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (addr == MAP_FAILED) {
+        throw std::runtime_error(std::string("map_shared: mmap: ") + strerror(errno));
+    }
+    return addr;
+}
+
+void
+unmap_shared(void* addr, size_t size)
+{
+    munmap(addr, size);
+}
+
+control_flag::control_flag()
+{
+    d_state = new (map_shared(sizeof(std::atomic<uint32_t>))) std::atomic<uint32_t>(0);
+}
+
+control_flag::~control_flag()
+{
+    unmap_shared(d_state, sizeof(std::atomic<uint32_t>));
+}
+
+void
+control_flag::set()
+{
+    store(true);
+}
+
+void
+control_flag::clear()
+{
+    store(false);
+}
+
+void
+control_flag::store(bool set)
+{
+    uint32_t state = d_state->load(std::memory_order_relaxed);
+    uint32_t next;
+    do {
+        next = ((sequence(state) + 1) << 1) | (set ? 1 : 0);
+    } while (!d_state->compare_exchange_weak(state, next, std::memory_order_release,
+                                             std::memory_order_relaxed));
+}
+
+bool
+control_flag::clear_if(uint32_t state)
+{
+    uint32_t next = (sequence(state) + 1) << 1;
+    return d_state->compare_exchange_strong(state, next, std::memory_order_release,
+                                            std::memory_order_relaxed);
+}
+
+} /* namespace msod_sensor */
+} /* namespace gr */
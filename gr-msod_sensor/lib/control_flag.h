@@ -0,0 +1,78 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef INCLUDED_MSOD_SENSOR_CONTROL_FLAG_H
+#define INCLUDED_MSOD_SENSOR_CONTROL_FLAG_H
+
+#include <atomic>
+#include <stdint.h>
+#include <stddef.h>
+
+namespace gr {
+  namespace msod_sensor {
+
+    // Zeroed anonymous memory that a forked child shares with us.
+    // Throws on failure.
+    void* map_shared(size_t size);
+    void unmap_shared(void* addr, size_t size);
+
+    /*!
+     * An arm/disarm (or start/stop) flag shared with forked processes.
+     *
+     * The flag lives in an anonymous shared page, so set() and clear()
+     * from a child of the flowgraph process (the command handler of
+     * sslsocket_sink) are seen by work(). The page holds one lock free
+     * std::atomic word: bit 0 is the flag, the rest a sequence number
+     * that every change bumps. Changes are published with release and
+     * read with acquire ordering.
+     *
+     * work() loads the word once per call and, when it acts on the flag
+     * (a trigger fired, a capture completed), clears it with clear_if()
+     * so a set() that arrived in the meantime is not lost.
+     */
+    class control_flag
+    {
+     public:
+      control_flag();
+      ~control_flag();
+
+      void set();
+      void clear();
+
+      uint32_t load() const { return d_state->load(std::memory_order_acquire); }
+      static bool is_set(uint32_t state) { return state & 1; }
+      static uint32_t sequence(uint32_t state) { return state >> 1; }
+      bool test() const { return is_set(load()); }
+
+      // Clear the flag if nothing changed it since state was loaded.
+      // Returns false (and leaves it alone) otherwise.
+      bool clear_if(uint32_t state);
+
+     private:
+      std::atomic<uint32_t>* d_state;
+
+      void store(bool set);
+    };
+
+  } // namespace msod_sensor
+} // namespace gr
+
+#endif /* INCLUDED_MSOD_SENSOR_CONTROL_FLAG_H */
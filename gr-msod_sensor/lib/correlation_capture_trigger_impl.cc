@@ -0,0 +1,248 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <stdexcept>
+#include <gnuradio/io_signature.h>
+#include <volk/volk.h>
+#include <pmt/pmt.h>
+#include "correlation_capture_trigger_impl.h"
+
+namespace gr {
+namespace msod_sensor {
+
+correlation_capture_trigger::sptr
+correlation_capture_trigger::make(const std::vector<std::vector<gr_complex> > &references,
+                                  float threshold, unsigned int fft_size)
+{
+    return gnuradio::get_initial_sptr
+           (new correlation_capture_trigger_impl(references, threshold, fft_size));
+}
+
+static size_t
+longest(const std::vector<std::vector<gr_complex> > &references)
+{
+    size_t length = 0;
+    for (size_t i = 0; i < references.size(); i++) {
+        if (references[i].empty()) {
+            throw std::invalid_argument("correlation_capture_trigger: empty reference");
+        }
+        length = std::max(length, references[i].size());
+    }
+    if (length == 0) {
+        throw std::invalid_argument("correlation_capture_trigger: no references");
+    }
+    return length;
+}
+
+/*
+ * The private constructor
+ */
+correlation_capture_trigger_impl::correlation_capture_trigger_impl(const std::vector<std::vector<gr_complex> > &references,
+        float threshold, unsigned int fft_size)
+    : gr::sync_block("correlation_capture_trigger",
+                     gr::io_signature::make(1, 1, sizeof(gr_complex)),
+                     gr::io_signature::make(0, 1, sizeof(gr_complex))),
+    d_overlap(longest(references))
+{
+    if (fft_size == 0) {
+        fft_size = 64;
+        while (fft_size < 4 * d_overlap) {
+            fft_size <<= 1;
+        }
+    }
+    if (fft_size < d_overlap) {
+        throw std::invalid_argument("correlation_capture_trigger: fft_size is shorter than a reference");
+    }
+    d_fft_size = fft_size;
+    d_step = fft_size - d_overlap + 1;
+    set_threshold(threshold);
+    d_forward = new gr::fft::fft_complex(fft_size, true);
+    d_inverse = new gr::fft::fft_complex(fft_size, false);
+    const size_t alignment = volk_get_alignment();
+    d_product = d_inverse->get_inbuf();
+    d_power = (float*) volk_malloc(fft_size * sizeof(float), alignment);
+    d_corr = (float*) volk_malloc(fft_size * sizeof(float), alignment);
+    d_energy.resize(fft_size + 1);
+
+    // Correlation is convolution with the conjugated, time reversed
+    // reference, i.e. multiplying by the conjugate of its spectrum. The
+    // 1/N undoes the gain of the unnormalized inverse FFT.
+    const float scale = 1.0 / fft_size;
+    for (size_t i = 0; i < references.size(); i++) {
+        const std::vector<gr_complex>& r = references[i];
+        correlation_reference ref;
+        ref.length = r.size();
+        ref.energy = 0;
+        for (size_t k = 0; k < r.size(); k++) {
+            ref.energy += std::norm(r[k]);
+        }
+        gr_complex* fft_in = d_forward->get_inbuf();
+        std::fill(fft_in, fft_in + fft_size, gr_complex(0));
+        memcpy(fft_in, &r[0], r.size() * sizeof(gr_complex));
+        d_forward->execute();
+        ref.spectrum = (gr_complex*) volk_malloc(fft_size * sizeof(gr_complex), alignment);
+        const gr_complex* spectrum = d_forward->get_outbuf();
+        for (unsigned int k = 0; k < fft_size; k++) {
+            ref.spectrum[k] = std::conj(spectrum[k]) * scale;
+        }
+        d_references.push_back(ref);
+    }
+
+    // Overlap-save: each FFT sees the d_overlap - 1 samples before the
+    // d_step new ones.
+    set_history(d_overlap);
+    set_output_multiple(d_step);
+    message_port_register_out(pmt::mp("trigger"));
+    GR_LOG_DEBUG(d_debug_logger,"correlation_capture_trigger: references " + std::to_string(d_references.size()) +
+                 " fft_size " + std::to_string(fft_size) + " step " + std::to_string(d_step));
+}
+
+/*
+ * Our virtual destructor.
+ */
+correlation_capture_trigger_impl::~correlation_capture_trigger_impl()
+{
+    for (size_t i = 0; i < d_references.size(); i++) {
+        volk_free(d_references[i].spectrum);
+    }
+    volk_free(d_power);
+    volk_free(d_corr);
+    delete d_forward;
+    delete d_inverse;
+}
+
+bool
+correlation_capture_trigger_impl::is_armed() {
+    return this->d_armed.test();
+}
+
+void
+correlation_capture_trigger_impl::arm() {
+    this->d_armed.set();
+    GR_LOG_DEBUG(d_debug_logger,"correlation_capture_trigger::arm");
+}
+
+void
+correlation_capture_trigger_impl::disarm() {
+    GR_LOG_DEBUG(d_debug_logger,"correlation_capture_trigger::disarm");
+    this->d_armed.clear();
+}
+
+void
+correlation_capture_trigger_impl::set_threshold(float threshold) {
+    if (threshold <= 0 || threshold > 1) {
+        throw std::invalid_argument("correlation_capture_trigger: threshold must be in (0, 1]");
+    }
+    d_threshold = threshold;
+}
+
+/*
+* Same message as level_capture_trigger, plus which reference matched.
+*/
+void
+correlation_capture_trigger_impl::publish_trigger(int reference, double correlation, uint64_t offset) {
+    pmt::pmt_t msg = pmt::make_dict();
+    msg = pmt::dict_add(msg, pmt::mp("trigger"), pmt::mp("start"));
+    msg = pmt::dict_add(msg, pmt::mp("offset"), pmt::from_uint64(offset));
+    msg = pmt::dict_add(msg, pmt::mp("window"), pmt::from_long(d_references[reference].length));
+    msg = pmt::dict_add(msg, pmt::mp("reference"), pmt::from_long(reference));
+    msg = pmt::dict_add(msg, pmt::mp("correlation"), pmt::from_double(correlation));
+    message_port_pub(pmt::mp("trigger"), msg);
+    GR_LOG_DEBUG(d_debug_logger,"correlation_capture_trigger::work pub reference " + std::to_string(reference) +
+                 " correlation " + std::to_string(correlation) + " offset " + std::to_string(offset));
+}
+
+/*
+* Output item m is input sample in[m + d_overlap - 1]. Every reference is
+* matched against the sequence that ends there, so each item is looked at
+* once per reference however long the reference is.
+*/
+int
+correlation_capture_trigger_impl::work(int noutput_items,
+                                       gr_vector_const_void_star &input_items,
+                                       gr_vector_void_star &output_items)
+{
+    const gr_complex *in = (const gr_complex *) input_items[0];
+    uint32_t control = this->d_armed.load();
+    bool armed = control_flag::is_set(control);
+    const double threshold2 = (double) d_threshold * d_threshold;
+
+    // Nothing to compute while disarmed.
+    for (int b = 0; armed && b < noutput_items; b += d_step) {
+        const gr_complex* block = in + b;
+        memcpy(d_forward->get_inbuf(), block, d_fft_size * sizeof(gr_complex));
+        d_forward->execute();
+        // Energy of any stretch of the block from a running sum.
+        volk_32fc_magnitude_squared_32f(d_power, block, d_fft_size);
+        d_energy[0] = 0;
+        for (unsigned int k = 0; k < d_fft_size; k++) {
+            d_energy[k + 1] = d_energy[k] + d_power[k];
+        }
+        int best_ref = -1;
+        int best_start = 0;
+        double best = 0;
+        for (size_t r = 0; r < d_references.size(); r++) {
+            const correlation_reference& ref = d_references[r];
+            volk_32fc_x2_multiply_32fc(d_product, d_forward->get_outbuf(), ref.spectrum, d_fft_size);
+            d_inverse->execute();
+            // The sequences that end at the block's d_step new samples.
+            size_t first = d_overlap - ref.length;
+            volk_32fc_magnitude_squared_32f(d_corr, d_inverse->get_outbuf() + first, d_step);
+            for (int n = 0; n < d_step; n++) {
+                // |c|^2 > t^2 Er Ex, without dividing.
+                double ex = d_energy[first + n + ref.length] - d_energy[first + n];
+                double bound = threshold2 * ref.energy * ex;
+                if (ex > 0 && d_corr[n] > bound) {
+                    double rho2 = d_corr[n] / (ref.energy * ex);
+                    if (rho2 > best) {
+                        best = rho2;
+                        best_ref = r;
+                        best_start = b + first + n;
+                    }
+                }
+            }
+        }
+        if (best_ref >= 0) {
+            // in[0] is d_overlap - 1 samples before the first item.
+            int64_t offset = (int64_t) nitems_read(0) + best_start - (int64_t) (d_overlap - 1);
+            publish_trigger(best_ref, sqrt(best), std::max(offset, (int64_t) 0));
+            // One shot, as level_capture_trigger. An arm that came in
+            // meanwhile stays.
+            this->d_armed.clear_if(control);
+            armed = false;
+        }
+    }
+
+    if (output_items.size() > 0) {
+        memcpy(output_items[0], in + d_overlap - 1, noutput_items * sizeof(gr_complex));
+    }
+    return noutput_items;
+}
+
+} /* namespace msod_sensor */
+} /* namespace gr */
+
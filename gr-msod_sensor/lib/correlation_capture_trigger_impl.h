@@ -0,0 +1,89 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_MSOD_SENSOR_CORRELATION_CAPTURE_TRIGGER_IMPL_H
+#define INCLUDED_MSOD_SENSOR_CORRELATION_CAPTURE_TRIGGER_IMPL_H
+
+#include <msod_sensor/correlation_capture_trigger.h>
+#include <gnuradio/fft/fft.h>
+#include "control_flag.h"
+
+namespace gr {
+  namespace msod_sensor {
+
+    // A reference sequence, ready to multiply the FFT of a block with.
+    struct correlation_reference
+    {
+      size_t length;
+      float energy;
+      // conj(FFT(r)) / fft_size (volk aligned).
+      gr_complex* spectrum;
+    };
+
+    class correlation_capture_trigger_impl : public correlation_capture_trigger
+    {
+     private:
+	unsigned int d_fft_size;
+	// Longest reference; the history is one less than this.
+	size_t d_overlap;
+	// New samples per FFT.
+	int d_step;
+	float d_threshold;
+	std::vector<correlation_reference> d_references;
+	// The plans are made once and reused for every block.
+	gr::fft::fft_complex* d_forward;
+	gr::fft::fft_complex* d_inverse;
+	// Product of the block's spectrum and a reference's (volk aligned).
+	gr_complex* d_product;
+	// |x|^2 of the block, then |correlation|^2 (volk aligned).
+	float* d_power;
+	float* d_corr;
+	// Running sum of |x|^2 over the block, for the sequence energies.
+	std::vector<double> d_energy;
+
+        // Shared with the command handler process that arms us.
+        control_flag d_armed;
+
+	void publish_trigger(int reference, double correlation, uint64_t offset);
+
+     public:
+      correlation_capture_trigger_impl(const std::vector<std::vector<gr_complex> > &references,
+                                       float threshold, unsigned int fft_size);
+      ~correlation_capture_trigger_impl();
+
+      // Where all the action really happens
+      int work(int noutput_items,
+	       gr_vector_const_void_star &input_items,
+	       gr_vector_void_star &output_items);
+
+      void arm();
+
+      void disarm();
+
+      bool is_armed();
+
+      void set_threshold(float threshold);
+    };
+
+  } // namespace msod_sensor
+} // namespace gr
+
+#endif /* INCLUDED_MSOD_SENSOR_CORRELATION_CAPTURE_TRIGGER_IMPL_H */
+
@@ -44,12 +44,10 @@ dummy_capture_trigger::make(size_t itemsize)
 dummy_capture_trigger_impl::dummy_capture_trigger_impl(size_t itemsize)
     : gr::block("dummy_capture_trigger",
                 gr::io_signature::make(1, 1, itemsize),
-                gr::io_signature::make(1, 1, itemsize))
+                gr::io_signature::make(0, 1, itemsize))
 {
     this->d_itemcount = 0;
     this->d_itemsize = itemsize;
-    this->d_armed = new boost::interprocess::mapped_region(boost::interprocess::anonymous_shared_memory(sizeof(int)));
-    memset(d_armed->get_address(), 0, d_armed->get_size());
     message_port_register_out(pmt::mp("trigger"));
 #ifdef IQCAPTURE_DEBUG
     prefs *p = prefs::singleton();
@@ -77,21 +75,19 @@ dummy_capture_trigger_impl::forecast (int noutput_items, gr_vector_int &ninput_i
 
 bool
 dummy_capture_trigger_impl::is_armed() {
-    int armed;
-    memcpy(&armed,this->d_armed->get_address(),sizeof(int));
-    return armed;
+    return this->d_armed.test();
 }
 
 void
 dummy_capture_trigger_impl::arm() {
-    memset(d_armed->get_address(), 1, sizeof(int));
+    this->d_armed.set();
     GR_LOG_DEBUG(d_debug_logger,"dummy_capture_trigger::arm " + std::to_string((long) this ) + " arm_flag " + std::to_string(this->is_armed()));
 }
 
 void
 dummy_capture_trigger_impl::disarm() {
     GR_LOG_DEBUG(d_debug_logger,"dummy_capture_trigger::disarm " );
-    memset(d_armed->get_address(), 0, sizeof(int));
+    this->d_armed.clear();
 }
 
 
@@ -103,21 +99,30 @@ dummy_capture_trigger_impl::general_work (int noutput_items,
 
 {
     const char *in = (const char *) input_items[0];
-    char *out = (char *) output_items[0];
     unsigned int byte_size = noutput_items * this->d_itemsize;
-    int buffercounter = 0;
     this->d_itemcount = this->d_itemcount + noutput_items;
+    // With the output left unconnected this block is a pure sink.
+    bool pass_through = output_items.size() > 0;
 
     // Just signal the capture block (TODO -- different policies go here).
-    if (this->is_armed()) {
+    // The trigger sample is the first one of this call.
+    uint32_t control = this->d_armed.load();
+    if (control_flag::is_set(control)) {
         GR_LOG_DEBUG(d_debug_logger,"dummy_capture_trigger::work pub" );
-        message_port_pub(pmt::mp("trigger"),pmt::intern(std::string("start")));
-        this->disarm();
+        uint64_t offset = nitems_read(0);
+        pmt::pmt_t msg = pmt::make_dict();
+        msg = pmt::dict_add(msg, pmt::mp("trigger"), pmt::mp("start"));
+        msg = pmt::dict_add(msg, pmt::mp("offset"), pmt::from_uint64(offset));
+        message_port_pub(pmt::mp("trigger"),msg);
+        if (pass_through) {
+            add_item_tag(0, offset, pmt::mp("trigger"), pmt::from_uint64(offset));
+        }
+        this->d_armed.clear_if(control);
     }
 
-    in = (char*)input_items[0];
-    byte_size = noutput_items * d_itemsize;
-    memcpy(out,in,byte_size);
+    if (pass_through) {
+        memcpy(output_items[0],in,byte_size);
+    }
     consume_each (noutput_items);
     return noutput_items;
 }
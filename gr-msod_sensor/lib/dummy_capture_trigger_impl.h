@@ -22,8 +22,7 @@
 #define INCLUDED_MSOD_SENSOR_DUMMY_CAPTURE_TRIGGER_IMPL_H
 
 #include <msod_sensor/dummy_capture_trigger.h>
-#include <boost/interprocess/anonymous_shared_memory.hpp>
-#include <boost/interprocess/mapped_region.hpp>
+#include "control_flag.h"
 
 namespace gr {
   namespace msod_sensor {
@@ -33,7 +32,8 @@ namespace gr {
      private:
 	int d_itemcount;
 	int d_itemsize;
-        boost::interprocess::mapped_region  * d_armed;
+        // Shared with the command handler process that arms us.
+        control_flag d_armed;
 	
      public:
       dummy_capture_trigger_impl(size_t itemsize);
@@ -0,0 +1,284 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <fstream>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include "event_outbox.h"
+
+namespace gr {
+namespace msod_sensor {
+
+// The log starts with the offset of the first undelivered event.
+static const uint64_t HEADER_SIZE = sizeof(uint64_t);
+
+event_outbox::event_outbox(const std::string& path, const std::string& url)
+    : d_publisher(url)
+{
+    d_path = path;
+    d_head = HEADER_SIZE;
+    d_tail = HEADER_SIZE;
+    d_pending = 0;
+    d_unsynced = false;
+    d_max_batch = 1;
+    d_min_backoff = 1;
+    d_max_backoff = 300;
+    d_done = false;
+    d_thread = NULL;
+    d_fd = open(path.c_str(), O_RDWR | O_CREAT, S_IWUSR | S_IRUSR);
+    if (d_fd < 0) {
+        return;
+    }
+    recover();
+    d_thread = new gr::thread::thread(boost::bind(&event_outbox::run_sender, this));
+}
+
+event_outbox::~event_outbox()
+{
+    if (d_thread != NULL) {
+        {
+            gr::thread::scoped_lock guard(d_mutex);
+            d_done = true;
+            d_cond.notify_all();
+        }
+        d_thread->join();
+        delete d_thread;
+    }
+    if (d_fd >= 0) {
+        fdatasync(d_fd);
+        close(d_fd);
+    }
+}
+
+/*
+* Find the undelivered events left in the log by an earlier run. An event cut
+* off by a crash in the middle of an append is dropped.
+*/
+void
+event_outbox::recover() {
+    struct stat statbuf;
+    fstat(d_fd, &statbuf);
+    uint64_t size = statbuf.st_size;
+    uint64_t head = 0;
+    if (size < HEADER_SIZE || pread(d_fd, &head, sizeof(head), 0) != sizeof(head)
+            || head < HEADER_SIZE || head > size) {
+        head = HEADER_SIZE;
+    }
+    std::vector<std::string> events;
+    uint64_t next = head;
+    d_pending = read_events(head, size, events, next);
+    d_head = head;
+    d_tail = next;
+    if (d_pending == 0) {
+        d_head = d_tail = HEADER_SIZE;
+    }
+    if (ftruncate(d_fd, d_tail) != 0) {
+        d_error = "cannot truncate the outbox";
+    }
+    write_head(d_head);
+}
+
+void
+event_outbox::write_head(uint64_t head) {
+    if (pwrite(d_fd, &head, sizeof(head), 0) != sizeof(head)) {
+        d_error = "cannot update the outbox header";
+    }
+}
+
+/*
+* Read the complete events stored in [from, to), appending them to events.
+* Sets next to the offset after the last one read.
+*/
+size_t
+event_outbox::read_events(uint64_t from, uint64_t to, std::vector<std::string>& events, uint64_t& next) {
+    size_t count = 0;
+    next = from;
+    while (next + sizeof(uint32_t) <= to) {
+        uint32_t length;
+        if (pread(d_fd, &length, sizeof(length), next) != sizeof(length)
+                || next + sizeof(length) + length > to) {
+            break;
+        }
+        std::string event(length, '\0');
+        if (pread(d_fd, &event[0], length, next + sizeof(length)) != (ssize_t) length) {
+            break;
+        }
+        events.push_back(event);
+        next += sizeof(length) + length;
+        count++;
+    }
+    return count;
+}
+
+bool
+event_outbox::append(const std::string& event) {
+    gr::thread::scoped_lock guard(d_mutex);
+    if (d_fd < 0) {
+        return false;
+    }
+    uint32_t length = event.size();
+    std::string record((const char*) &length, sizeof(length));
+    record += event;
+    if (pwrite(d_fd, record.data(), record.size(), d_tail) != (ssize_t) record.size()) {
+        return false;
+    }
+    d_tail += record.size();
+    d_pending++;
+    d_unsynced = true;
+    d_cond.notify_all();
+    return true;
+}
+
+size_t
+event_outbox::pending() {
+    gr::thread::scoped_lock guard(d_mutex);
+    return d_pending;
+}
+
+void
+event_outbox::set_max_batch(size_t max_batch) {
+    gr::thread::scoped_lock guard(d_mutex);
+    d_max_batch = std::max((size_t) 1, max_batch);
+}
+
+void
+event_outbox::set_backoff(double min_backoff, double max_backoff) {
+    gr::thread::scoped_lock guard(d_mutex);
+    d_min_backoff = min_backoff;
+    d_max_backoff = std::max(min_backoff, max_backoff);
+}
+
+std::string
+event_outbox::last_error() {
+    gr::thread::scoped_lock guard(d_mutex);
+    return d_error;
+}
+
+void
+event_outbox::advance(size_t count, uint64_t next) {
+    d_pending -= count;
+    d_head = next;
+    if (d_head == d_tail) {
+        // All delivered: start the log over.
+        d_head = d_tail = HEADER_SIZE;
+        if (ftruncate(d_fd, HEADER_SIZE) != 0) {
+            d_error = "cannot truncate the outbox";
+        }
+    }
+    write_head(d_head);
+}
+
+/*
+* Keep a rejected event where someone can look at it, out of the way of the
+* ones still to be delivered.
+*/
+void
+event_outbox::dead_letter(const std::string& event) {
+    std::ofstream rejected((d_path + ".rejected").c_str(), std::ios::app);
+    rejected << event << std::endl;
+    if (!rejected) {
+        d_error = "cannot write the rejected events file";
+    }
+}
+
+/**
+* Sender thread. Makes appended events durable, then delivers them oldest first.
+*/
+void
+event_outbox::run_sender() {
+    gr::thread::scoped_lock guard(d_mutex);
+    double backoff = 0;
+    // Set after a rejected batch, to find the event at fault.
+    bool one_by_one = false;
+    while (true) {
+        while (d_pending == 0 && !d_done) {
+            d_cond.wait(guard);
+        }
+        if (d_done) {
+            // Whatever is left stays in the log for the next run.
+            return;
+        }
+        bool sync = d_unsynced;
+        d_unsynced = false;
+        uint64_t head = d_head;
+        uint64_t tail = d_tail;
+        size_t pending = d_pending;
+        size_t max_batch = one_by_one ? 1 : d_max_batch;
+        guard.unlock();
+
+        if (sync) {
+            fdatasync(d_fd);
+        }
+        std::vector<std::string> events;
+        uint64_t next;
+        // Only the sender moves the head, and appends only go past the tail.
+        read_events(head, tail, events, next);
+        if (events.size() > max_batch) {
+            events.resize(max_batch);
+            next = head;
+            for (size_t i = 0; i < events.size(); i++) {
+                next += sizeof(uint32_t) + events[i].size();
+            }
+        }
+        if (events.empty()) {
+            // The log up to tail cannot be read back; give up on it, and on
+            // disk too, so the next run does not try again.
+            guard.lock();
+            d_error = "cannot read the outbox";
+            advance(pending, tail);
+            continue;
+        }
+        bool sent = d_publisher.send(events);
+        bool rejected = !sent && d_publisher.rejected();
+        if (rejected && events.size() == 1) {
+            dead_letter(events[0]);
+        }
+
+        guard.lock();
+        if (sent) {
+            backoff = 0;
+            one_by_one = false;
+            advance(events.size(), next);
+        } else if (rejected && events.size() > 1) {
+            // Resend this batch one event at a time, straight away.
+            one_by_one = true;
+        } else if (rejected) {
+            // Retrying would block the events behind it for good.
+            d_error = "event rejected with " + d_publisher.last_error() + ", moved to " + d_path + ".rejected";
+            backoff = 0;
+            advance(1, next);
+        } else {
+            d_error = d_publisher.last_error();
+            backoff = backoff == 0 ? d_min_backoff : std::min(2 * backoff, d_max_backoff);
+            // Wait before retrying; stopping the outbox cuts the wait short.
+            d_cond.timed_wait(guard, boost::posix_time::milliseconds((long) (backoff * 1000)));
+        }
+    }
+}
+
+} /* namespace msod_sensor */
+} /* namespace gr */
@@ -0,0 +1,107 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_MSOD_SENSOR_EVENT_OUTBOX_H
+#define INCLUDED_MSOD_SENSOR_EVENT_OUTBOX_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <gnuradio/thread/thread.h>
+#include "event_publisher.h"
+
+namespace gr {
+  namespace msod_sensor {
+
+    /*!
+     * Durable queue of capture events waiting to be POSTed.
+     *
+     * Events are appended to a log file and a background thread sends them
+     * in order, retrying with exponential backoff while the server cannot
+     * be reached. The log starts with the file offset of the first event
+     * not yet delivered, followed by the events, each a 32 bit length and
+     * the JSON text. Appends do not wait for the disk: the sender thread
+     * syncs everything appended so far before it sends, so a burst of
+     * events costs one fdatasync. Undelivered events left by an earlier
+     * run are sent when the outbox is opened again. Delivery is at least
+     * once: a crash right after a send can repeat it.
+     *
+     * An event the server rejects outright (4xx other than 408 and 429)
+     * would block everything behind it if retried, so it is moved to the
+     * dead letter file path + ".rejected", one JSON event per line, and
+     * the events after it go on. A rejected batch is resent one event at
+     * a time to find the ones at fault.
+     */
+    class event_outbox
+    {
+     private:
+      std::string d_path;
+      int      d_fd;
+      // Offsets of the first undelivered event and of the end of the log.
+      uint64_t d_head;
+      uint64_t d_tail;
+      size_t   d_pending;
+      bool     d_unsynced;
+      size_t   d_max_batch;
+      double   d_min_backoff;
+      double   d_max_backoff;
+      std::string d_error;
+      event_publisher d_publisher;
+
+      gr::thread::mutex d_mutex;
+      gr::thread::condition_variable d_cond;
+      gr::thread::thread* d_thread;
+      bool     d_done;
+
+      void recover();
+      void write_head(uint64_t head);
+      size_t read_events(uint64_t from, uint64_t to, std::vector<std::string>& events, uint64_t& next);
+      void run_sender();
+      // The count events up to next are done with (d_mutex held).
+      void advance(size_t count, uint64_t next);
+      void dead_letter(const std::string& event);
+
+     public:
+      event_outbox(const std::string& path, const std::string& url);
+      ~event_outbox();
+
+      // False if the log file could not be opened.
+      bool is_open() const { return d_fd >= 0; }
+
+      // Queue an event for delivery.
+      bool append(const std::string& event);
+
+      // Events not delivered yet.
+      size_t pending();
+
+      // Events sent per request (as a JSON array when more than one).
+      void set_max_batch(size_t max_batch);
+
+      // Retry delays in seconds, doubling from min up to max.
+      void set_backoff(double min_backoff, double max_backoff);
+
+      // Why the last delivery attempt failed.
+      std::string last_error();
+    };
+
+  } // namespace msod_sensor
+} // namespace gr
+
+#endif /* INCLUDED_MSOD_SENSOR_EVENT_OUTBOX_H */
@@ -0,0 +1,131 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <algorithm>
+#include "event_publisher.h"
+
+namespace gr {
+namespace msod_sensor {
+
+// The server's reply is not used; keep it off stdout.
+static size_t
+discard_reply(char* ptr, size_t size, size_t nmemb, void* userdata)
+{
+    return size * nmemb;
+}
+
+event_publisher::event_publisher(const std::string& url)
+{
+    d_url = url;
+    d_max_batch = 1;
+    d_rejected = false;
+    d_headers = curl_slist_append(NULL, "Content-Type: application/json");
+    d_curl = curl_easy_init();
+    if (d_curl != NULL) {
+        curl_easy_setopt(d_curl, CURLOPT_URL, d_url.c_str());
+        curl_easy_setopt(d_curl, CURLOPT_HTTPHEADER, d_headers);
+        curl_easy_setopt(d_curl, CURLOPT_POST, 1L);
+        curl_easy_setopt(d_curl, CURLOPT_TCP_KEEPALIVE, 1L);
+        curl_easy_setopt(d_curl, CURLOPT_NOSIGNAL, 1L);
+        curl_easy_setopt(d_curl, CURLOPT_CONNECTTIMEOUT, 10L);
+        curl_easy_setopt(d_curl, CURLOPT_TIMEOUT, 30L);
+        curl_easy_setopt(d_curl, CURLOPT_WRITEFUNCTION, discard_reply);
+        curl_easy_setopt(d_curl, CURLOPT_SSL_VERIFYPEER, 0L); // TODO -- enable this check after official cert is installed.
+        curl_easy_setopt(d_curl, CURLOPT_SSL_VERIFYHOST, 0L); // TODO -- make this 2L for strict check after official cert installed.
+    }
+}
+
+event_publisher::~event_publisher()
+{
+    flush();
+    if (d_curl != NULL) {
+        curl_easy_cleanup(d_curl);
+    }
+    curl_slist_free_all(d_headers);
+}
+
+void
+event_publisher::set_max_batch(size_t max_batch) {
+    d_max_batch = std::max((size_t) 1, max_batch);
+}
+
+bool
+event_publisher::publish(const std::string& event) {
+    d_batch.push_back(event);
+    if (d_batch.size() < d_max_batch) {
+        return true;
+    }
+    return flush();
+}
+
+bool
+event_publisher::flush() {
+    if (d_batch.empty()) {
+        return true;
+    }
+    bool ok = send(d_batch);
+    d_batch.clear();
+    return ok;
+}
+
+bool
+event_publisher::send(const std::vector<std::string>& events) {
+    if (events.size() == 1) {
+        return post(events[0]);
+    }
+    std::string body = "[";
+    for (size_t i = 0; i < events.size(); i++) {
+        body += (i == 0 ? "" : ",") + events[i];
+    }
+    body += "]";
+    return post(body);
+}
+
+bool
+event_publisher::post(const std::string& body) {
+    d_rejected = false;
+    if (d_curl == NULL) {
+        d_error = "curl initialization not successful";
+        return false;
+    }
+    curl_easy_setopt(d_curl, CURLOPT_POSTFIELDS, body.c_str());
+    curl_easy_setopt(d_curl, CURLOPT_POSTFIELDSIZE, (long) body.size());
+    CURLcode res = curl_easy_perform(d_curl);
+    if (res != CURLE_OK) {
+        d_error = curl_easy_strerror(res);
+        return false;
+    }
+    long status = 0;
+    curl_easy_getinfo(d_curl, CURLINFO_RESPONSE_CODE, &status);
+    if (status >= 400) {
+        d_error = "HTTP status " + std::to_string(status);
+        // Request timeout and too many requests are worth another try.
+        d_rejected = status < 500 && status != 408 && status != 429;
+        return false;
+    }
+    return true;
+}
+
+} /* namespace msod_sensor */
+} /* namespace gr */
@@ -0,0 +1,81 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_MSOD_SENSOR_EVENT_PUBLISHER_H
+#define INCLUDED_MSOD_SENSOR_EVENT_PUBLISHER_H
+
+#include <string>
+#include <vector>
+#include <curl/curl.h>
+
+namespace gr {
+  namespace msod_sensor {
+
+    /*!
+     * POSTs capture events (JSON objects) to the MSOD server.
+     *
+     * One curl handle is kept for the life of the publisher, so the TCP
+     * and TLS connection to the server is reused from one event to the
+     * next instead of being set up for every capture. Events can also be
+     * batched: up to max_batch events are collected and sent as one JSON
+     * array. Not thread safe; it is used from the capture writer thread.
+     */
+    class event_publisher
+    {
+     private:
+      std::string d_url;
+      CURL*  d_curl;
+      struct curl_slist* d_headers;
+      size_t d_max_batch;
+      std::vector<std::string> d_batch;
+      std::string d_error;
+      bool   d_rejected;
+
+      bool post(const std::string& body);
+
+     public:
+      event_publisher(const std::string& url);
+      ~event_publisher();
+
+      // 1 (the default) posts every event as soon as it is published.
+      void set_max_batch(size_t max_batch);
+
+      // Post an event, or add it to the batch (posted once it is full).
+      bool publish(const std::string& event);
+
+      // Post whatever is batched. Call when a burst of events is over.
+      bool flush();
+
+      // Post these events right away, as one request.
+      bool send(const std::vector<std::string>& events);
+
+      size_t batched() const { return d_batch.size(); }
+      // Why the last post failed.
+      const std::string& last_error() const { return d_error; }
+      // True if the last post failed because the server refused the
+      // request itself (a 4xx status other than 408 and 429). Sending it
+      // again will not help, unlike transport errors and 5xx.
+      bool rejected() const { return d_rejected; }
+    };
+
+  } // namespace msod_sensor
+} // namespace gr
+
+#endif /* INCLUDED_MSOD_SENSOR_EVENT_PUBLISHER_H */
@@ -25,6 +25,9 @@
 #include <gnuradio/io_signature.h>
 #include <gnuradio/prefs.h>
 #include <pmt/pmt.h>
+#include <errno.h>
+#include <sys/uio.h>
+#include <algorithm>
 #include "iqcapture_sink_impl.h"
 
 #define IQCAPTURE_DEBUG
@@ -33,37 +36,36 @@ namespace gr {
 namespace msod_sensor {
 
 iqcapture_sink::sptr
-iqcapture_sink::make(size_t itemsize, size_t chunksize, char* capture_dir, int mongodb_port)
+iqcapture_sink::make(size_t itemsize, size_t chunksize, char* capture_dir, int mongodb_port, bool double_mapped, double samp_rate)
 {
     return gnuradio::get_initial_sptr
-           (new iqcapture_sink_impl(itemsize, chunksize, capture_dir,mongodb_port));
+           (new iqcapture_sink_impl(itemsize, chunksize, capture_dir,mongodb_port,double_mapped,samp_rate));
 }
 
 /*
  * The private constructor
  */
-iqcapture_sink_impl::iqcapture_sink_impl(size_t itemsize, size_t chunksize, char* capture_dir, int mongodb_port)
+iqcapture_sink_impl::iqcapture_sink_impl(size_t itemsize, size_t chunksize, char* capture_dir, int mongodb_port, bool double_mapped, double samp_rate)
     : gr::sync_block("iqcapture_sink",
                      gr::io_signature::make(1, 1, itemsize),
-                     gr::io_signature::make(0, 0, 0))
+                     gr::io_signature::make(0, 0, 0)),
+      d_clock(samp_rate)
 {
     this->d_itemsize = itemsize;
     this->d_capture_dir = capture_dir;
     this->d_chunksize = chunksize;
     this->d_itemcount = 0;
     this->d_current_capture_file = NULL;
+    this->d_history = new capture_ring(itemsize, chunksize, double_mapped);
+    this->d_captured_until = 0;
     message_port_register_in(pmt::mp("capture"));
     set_msg_handler(pmt::mp("capture"),boost::bind(&iqcapture_sink_impl::capture, this, _1));
-    std::string errmsg;
-    try {
-        if (!this->d_mongo_client.connect(std::string("127.0.0.1:") + std::to_string(mongodb_port),errmsg)) {
-            GR_LOG_ERROR(d_debug_logger,"failed to initialize the client driver");
-            throw std::runtime_error("cannot connect to Mongo Client");
-        }
-    } catch (std::exception& e) {
-        GR_LOG_ERROR(d_debug_logger,"Unexpected exception");
-        throw e;
-    }
+    // mongod need not be up yet; the metadata writer connects when it has records.
+    this->d_mongodb_port = mongodb_port;
+    this->d_metadata_acknowledged = true;
+    this->d_metadata = metadata_writer::get(mongodb_port > 0 ? metadata_writer::BACKEND_MONGO
+                                                             : metadata_writer::BACKEND_NONE,
+                                            std::to_string(mongodb_port));
 #ifdef IQCAPTURE_DEBUG
     prefs *p = prefs::singleton();
     std::string log_level = p->get_string("LOG", "log_level", "debug");
@@ -77,6 +79,40 @@ iqcapture_sink_impl::iqcapture_sink_impl(size_t itemsize, size_t chunksize, char
  */
 iqcapture_sink_impl::~iqcapture_sink_impl()
 {
+    delete this->d_history;
+}
+
+bool
+iqcapture_sink_impl::stop()
+{
+    // Give the records of the last captures a moment to reach mongod.
+    metadata_writer::sptr metadata;
+    {
+        gr::thread::scoped_lock guard(this->d_metadata_mutex);
+        metadata = this->d_metadata;
+    }
+    if (!metadata->flush(5.0)) {
+        GR_LOG_ERROR(d_debug_logger,"iqcapture_sink_impl::stop: capture records still queued: " + metadata->last_error());
+    }
+    return true;
+}
+
+void
+iqcapture_sink_impl::set_metadata_backend(int backend, char* path)
+{
+    std::string target = backend == metadata_writer::BACKEND_MONGO ? std::to_string(this->d_mongodb_port) : std::string(path);
+    metadata_writer::sptr metadata = metadata_writer::get(backend, target);
+    gr::thread::scoped_lock guard(this->d_metadata_mutex);
+    metadata->set_acknowledged(this->d_metadata_acknowledged);
+    this->d_metadata = metadata;
+}
+
+void
+iqcapture_sink_impl::set_metadata_acknowledged(bool acknowledged)
+{
+    gr::thread::scoped_lock guard(this->d_metadata_mutex);
+    this->d_metadata_acknowledged = acknowledged;
+    this->d_metadata->set_acknowledged(acknowledged);
 }
 
 // Write out whatever is in our capture buffer to a file.
@@ -89,21 +125,43 @@ iqcapture_sink_impl::capture(pmt::pmt_t msg) {
     GR_LOG_DEBUG(d_debug_logger,"capture_sink_imp::capture")
 #endif
     int fd = open(this->d_current_capture_file->c_str(), O_APPEND | O_RDWR | O_CREAT, S_IWUSR | S_IRUSR);
-    int buffercounter = 0;
-    int itemcount = 0;
-    // Write the items out from the buffer.
-    for (std::list<char*>::iterator p  = this->d_capture_queue.begin();
-            p != this->d_capture_queue.end(); p++) {
-        buffercounter += d_itemsize;
-        int written = write(fd,*p,d_itemsize);
-        itemcount ++;
+    if (fd < 0) {
+        GR_LOG_ERROR(d_debug_logger,"iqcapture_sink_impl::capture: open failed on : " + *this->d_current_capture_file);
+        return;
+    }
+    // The history not yet captured, oldest first, in at most two pieces.
+    uint64_t end = this->d_history->items_written();
+    size_t nitems = std::min((uint64_t) this->d_chunksize, end - this->d_captured_until);
+    struct iovec iov[2];
+    int iovcnt = this->d_history->regions(iov, end, nitems);
+    uint64_t start_sample = end - nitems;
+    this->d_captured_until = end;
+    size_t buffercounter = 0;
+    int i = 0;
+    while (i < iovcnt) {
+        ssize_t written = writev(fd, &iov[i], iovcnt - i);
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            GR_LOG_ERROR(d_debug_logger,"iqcapture_sink_impl::capture: write failed on : " + *this->d_current_capture_file);
+            break;
+        }
+        buffercounter += written;
+        // Skip past whatever was fully written and trim a partially written region.
+        while (i < iovcnt && (size_t) written >= iov[i].iov_len) {
+            written -= iov[i].iov_len;
+            i++;
+        }
+        if (i < iovcnt) {
+            iov[i].iov_base = (char*) iov[i].iov_base + written;
+            iov[i].iov_len -= written;
+        }
     }
     close(fd);
+    this->d_itemcount = buffercounter / this->d_itemsize;
 #ifdef IQCAPTURE_DEBUG
-    GR_LOG_DEBUG(d_debug_logger,"capture_sink_imp::capture wrote " + std::to_string(buffercounter) + " bytes; itemcount = " + std::to_string(itemcount));
+    GR_LOG_DEBUG(d_debug_logger,"capture_sink_imp::capture wrote " + std::to_string(buffercounter) + " bytes; itemcount = " + std::to_string(this->d_itemcount));
 #endif
-    this->d_capture_queue.clear();
-    this->d_itemcount = 0;
     time_t  timev;
     time(&timev);
     mongo::BSONObjBuilder builder;
@@ -112,14 +170,22 @@ iqcapture_sink_impl::capture(pmt::pmt_t msg) {
                                   .append("_capture_file",*this->d_current_capture_file)
                                   .append("_capture_time",std::to_string(timev))
                                   .append("_sample_count",std::to_string(this->d_itemcount))
+                                  .appendNumber("_start_sample",(long long) start_sample)
                                   .obj();
-    // Insert the message into mongodb.
-    try {
-        this->d_mongo_client.insert("iqcapture.dataMessages",data_message);
-    } catch (mongo::DBException& e) {
-        GR_LOG_ERROR(d_debug_logger,"capture_sink_impl::Error inserting into mongodb ");
-        return ;
+    if (this->d_clock.valid()) {
+        mongo::BSONObjBuilder timed;
+        timed.appendElements(data_message);
+        data_message = timed.appendNumber("_start_time_ns",(long long) this->d_clock.time_ns(start_sample))
+                       .append("_time_source",this->d_clock.from_device() ? "rx_time" : "host")
+                       .obj();
+    }
+    // Queue the message for mongodb; the metadata writer inserts it in the background.
+    metadata_writer::sptr metadata;
+    {
+        gr::thread::scoped_lock guard(this->d_metadata_mutex);
+        metadata = this->d_metadata;
     }
+    metadata->insert("iqcapture.dataMessages",data_message);
 #ifdef IQCAPTURE_DEBUG
     GR_LOG_DEBUG(d_debug_logger,"capture_sink_impl::data_message " + data_message.toString());
 #endif
@@ -166,27 +232,16 @@ iqcapture_sink_impl::work(int noutput_items,
                           gr_vector_void_star &output_items)
 {
     const char *in = (const char *) input_items[0];
-    char *out = (char *) output_items[0];
-    unsigned int byte_size = noutput_items * this->d_itemsize;
 #ifdef IQCAPTURE_DEBUG
-    GR_LOG_DEBUG(d_debug_logger,"iqcapture_sink_impl::work byte_size " + std::to_string(byte_size));
     GR_LOG_DEBUG(d_debug_logger,"iqcapture_sink_impl::work noutput_items " + std::to_string(noutput_items));
 #endif
-    int buffercounter = 0;
-    for (int i = 0 ; i < noutput_items; i++) {
-        if ( this->d_itemcount >= this->d_chunksize) {
-            char* item = this->d_capture_queue.back();
-            this->d_capture_queue.pop_back();
-            delete item;
-            this->d_itemcount --;
-        }
-        char* item = (char*) in + buffercounter;
-        char* newitem = new char[d_itemsize];
-        memcpy(newitem,item,d_itemsize);
-        this->d_capture_queue.push_front(newitem);
-        buffercounter += this->d_itemsize;
-        this->d_itemcount++;
-    }
+    uint64_t nread = nitems_read(0);
+    std::vector<tag_t> tags;
+    get_tags_in_range(tags, 0, nread, nread + noutput_items);
+    this->d_clock.handle_tags(tags);
+    this->d_clock.anchor(nread + noutput_items);
+    // Older items fall off the end of the ring.
+    this->d_history->write(in, noutput_items);
     return noutput_items;
 }
 }/* namespace msod_sensor */
@@ -28,7 +28,9 @@
 #include <msod_sensor/capture_sink.h>
 #include <pmt/pmt.h>
 #include <fstream>
-#include <list>
+#include "capture_ring.h"
+#include "sample_clock.h"
+#include "metadata_writer.h"
 namespace gr {
   namespace msod_sensor {
 
@@ -45,10 +47,18 @@ namespace gr {
       mongo::BSONObj d_data_message;
       std::ofstream d_logfile;
       std::string* d_current_capture_file;
-      mongo::DBClientConnection d_mongo_client;
-      // I/Q samples are stored in this queue and written out 
-      // on a start-capture command
-      std::list<char*> d_capture_queue;
+      // Shared background inserter for the capture records.
+      metadata_writer::sptr d_metadata;
+      gr::thread::mutex d_metadata_mutex;
+      bool d_metadata_acknowledged;
+      int d_mongodb_port;
+      // The most recent chunksize I/Q samples are kept in this ring
+      // and written out on a start-capture command
+      capture_ring* d_history;
+      // Items up to here were written out by an earlier capture.
+      uint64_t d_captured_until;
+      // Sample index to time, from rx_time tags or the host clock.
+      sample_clock d_clock;
 
       void generate_timestamp();
       // start capture and write out whatever is in the buffer.
@@ -56,8 +66,11 @@ namespace gr {
       // LTE downlink).
       void capture(pmt::pmt_t msg);
      public:
-      iqcapture_sink_impl(size_t itemsize, size_t chunksize, char* capture_dir,int mongodb_port);
+      iqcapture_sink_impl(size_t itemsize, size_t chunksize, char* capture_dir,int mongodb_port, bool double_mapped, double samp_rate);
       ~iqcapture_sink_impl();
+      bool stop();
+      void set_metadata_backend(int backend, char* path);
+      void set_metadata_acknowledged(bool acknowledged);
       // set the sensor id (for posting to the database).
       void set_data_message(char* data_message);
       // Where all the action really happens
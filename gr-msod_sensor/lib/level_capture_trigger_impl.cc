@@ -23,7 +23,9 @@
 #endif
 
 #include <math.h>
+#include <algorithm>
 #include <gnuradio/io_signature.h>
+#include <volk/volk.h>
 #include <pmt/pmt.h>
 #include <gnuradio/prefs.h>
 #include "level_capture_trigger_impl.h"
@@ -32,33 +34,74 @@
 namespace gr {
 namespace msod_sensor {
 
+// Input is processed in blocks of this many samples so the power
+// scratch buffer stays in cache.
+static const int POWER_BLOCK_SIZE = 8192;
+
 level_capture_trigger::sptr
-level_capture_trigger::make(size_t itemsize, int level, size_t window_size)
+level_capture_trigger::make(size_t itemsize, int level, size_t window_size, int mode,
+                            const std::vector<unsigned int> &window_sizes)
 {
     return gnuradio::get_initial_sptr
-           (new level_capture_trigger_impl(itemsize,level,window_size));
+           (new level_capture_trigger_impl(itemsize,level,window_size,mode,window_sizes));
+}
+
+// One shot at the given level, as before there were settings.
+static trigger_settings
+initial_settings(int level)
+{
+    trigger_settings settings;
+    settings.level = level;
+    settings.holdoff = -1;
+    settings.hysteresis = 0;
+    settings.max_per_minute = 0;
+    settings.cfar_margin = 0;
+    settings.cfar_windows = 32;
+    return settings;
 }
 
 /*
  * The private constructor
  */
-level_capture_trigger_impl::level_capture_trigger_impl(size_t itemsize, int level, size_t window_size)
+level_capture_trigger_impl::level_capture_trigger_impl(size_t itemsize, int level, size_t window_size, int mode,
+        const std::vector<unsigned int> &window_sizes)
     : gr::block("level_capture_trigger",
                 gr::io_signature::make(1, 1, itemsize),
-                gr::io_signature::make(1, 1, itemsize))
+                gr::io_signature::make(0, 1, itemsize)),
+    d_cfar(false), d_arm_seen(0), d_policy(initial_settings(level)), d_policy_seen(0)
 {
-    // power level in dbm -- conver to actual value.
-    this->d_level = pow(10.0,(float)level/10.0);
-    this->d_window_size = window_size;
+    this->d_mode = mode == SLIDING ? SLIDING : BLOCK;
     this->d_itemcount = 0;
     this->d_itemsize = itemsize;
     this->d_logging_enabled = true;
-    // initialize accumulators.
-    this->d_power_in_window = 0;
-    this->d_window_counter = 0;
-    // Shared memory because this is signalled from a separate process that reads commands from the server.
-    this->d_armed = new boost::interprocess::mapped_region(boost::interprocess::anonymous_shared_memory(sizeof(int)));
-    memset(d_armed->get_address(), 0, d_armed->get_size());
+    this->d_was_armed = false;
+    // One accumulator per window length.
+    size_t max_window = 0;
+    for (size_t i = 0; i <= window_sizes.size(); i++) {
+        power_window w;
+        w.size = i == 0 ? window_size : window_sizes[i - 1];
+        if (w.size == 0) {
+            throw std::runtime_error("level_capture_trigger: window size must be positive");
+        }
+        w.ready = true;
+        d_windows.push_back(w);
+        max_window = std::max(max_window, w.size);
+    }
+    // The sliding windows need the power of the sample leaving each window.
+    size_t history_size = 1;
+    if (d_mode == SLIDING) {
+        while (history_size < max_window + 1) {
+            history_size <<= 1;
+        }
+    }
+    d_policy.poll(d_settings, d_policy_seen);
+    apply_settings();
+    this->d_history.resize(history_size);
+    this->d_history_mask = history_size - 1;
+    reset_windows();
+    this->d_power = (float*) volk_malloc(POWER_BLOCK_SIZE * sizeof(float), volk_get_alignment());
+    const int alignment_multiple = volk_get_alignment() / itemsize;
+    set_alignment(std::max(1,alignment_multiple));
     message_port_register_out(pmt::mp("trigger"));
 #ifdef IQCAPTURE_DEBUG
     prefs *p = prefs::singleton();
@@ -70,7 +113,8 @@ level_capture_trigger_impl::level_capture_trigger_impl(size_t itemsize, int leve
     GR_LOG_SET_LEVEL(d_debug_logger,log_level);
 #endif
     GR_LOG_DEBUG(d_debug_logger,"level_capture_trigger::level_capture_trigger: itemsize = " + std::to_string(itemsize) +
-                 " level = " + std::to_string(level)  + " level (energy) " +  std::to_string(this->d_level) + " window_size = " + std::to_string(window_size))
+                 " level = " + std::to_string(level)  + " level (energy) " +  std::to_string(this->d_level) + " window_size = " + std::to_string(window_size) +
+                 " mode = " + std::to_string(d_mode) + " windows = " + std::to_string(d_windows.size()))
 }
 
 /*
@@ -78,6 +122,7 @@ level_capture_trigger_impl::level_capture_trigger_impl(size_t itemsize, int leve
  */
 level_capture_trigger_impl::~level_capture_trigger_impl()
 {
+    volk_free(d_power);
 }
 
 void
@@ -88,23 +133,235 @@ level_capture_trigger_impl::forecast (int noutput_items, gr_vector_int &ninput_i
 
 bool
 level_capture_trigger_impl::is_armed() {
-    int armed;
-    memcpy(&armed,this->d_armed->get_address(),sizeof(int));
-    return armed;
+    return this->d_armed.test();
 }
 
 void
 level_capture_trigger_impl::arm() {
-    memset(d_armed->get_address(), 1, sizeof(int));
+    this->d_armed.set();
     GR_LOG_DEBUG(d_debug_logger,"level_capture_trigger::arm " + std::to_string((long) this ) + " arm_flag " + std::to_string(this->is_armed()));
 }
 
 void
 level_capture_trigger_impl::disarm() {
     GR_LOG_DEBUG(d_debug_logger,"level_capture_trigger::disarm " );
-    memset(d_armed->get_address(), 0, sizeof(int));
+    this->d_armed.clear();
+}
+
+
+void
+level_capture_trigger_impl::set_trigger_params(char* params) {
+    d_policy.set_json(std::string(params));
+    GR_LOG_DEBUG(d_debug_logger,"level_capture_trigger::set_trigger_params " + std::string(params));
+}
+
+/*
+* Thresholds for the current settings.
+*/
+void
+level_capture_trigger_impl::apply_settings() {
+    // power level in dbm -- conver to actual value.
+    this->d_level = pow(10.0, d_settings.level / 10.0);
+    this->d_falling_ratio = pow(10.0, -d_settings.hysteresis / 10.0);
+    bool cfar = d_settings.cfar_margin > 0;
+    this->d_cfar_ratio = pow(10.0, d_settings.cfar_margin / 10.0);
+    for (size_t i = 0; i < d_windows.size(); i++) {
+        power_window& w = d_windows[i];
+        if (cfar && (!d_cfar || w.noise.length() != (size_t) d_settings.cfar_windows)) {
+            // A floor from before CFAR was turned on would be stale.
+            w.noise.reset(d_settings.cfar_windows);
+        }
+    }
+    this->d_cfar = cfar;
+    for (size_t i = 0; i < d_windows.size(); i++) {
+        update_threshold(d_windows[i]);
+    }
+}
+
+void
+level_capture_trigger_impl::update_threshold(power_window& w) {
+    if (d_cfar) {
+        // Don't fire until there is a floor to go by.
+        w.threshold = w.noise.full() ? w.noise.value() * d_cfar_ratio : HUGE_VAL;
+    } else {
+        w.threshold = d_level * w.size;
+    }
+    w.falling = w.threshold * d_falling_ratio;
+}
+
+/*
+* CFAR: one more disjoint window of noise. O(1), amortized.
+*/
+void
+level_capture_trigger_impl::add_noise(power_window& w) {
+    w.noise.add(w.sum);
+    update_threshold(w);
+}
+
+/*
+* True while waiting out the holdoff after a trigger, or while the
+* triggers of the last minute are at the limit.
+*/
+bool
+level_capture_trigger_impl::holding_off(clock::time_point now) {
+    if (now < d_holdoff_until) {
+        return true;
+    }
+    while (!d_fired.empty() && now - d_fired.front() >= std::chrono::seconds(60)) {
+        d_fired.pop_front();
+    }
+    return d_settings.max_per_minute > 0 && d_fired.size() >= (size_t) d_settings.max_per_minute;
+}
+
+/*
+* After publishing a trigger: disarm (one shot) or start the holdoff.
+*/
+void
+level_capture_trigger_impl::after_trigger(uint32_t control) {
+    clock::time_point now = clock::now();
+    d_fired.push_back(now);
+    if (d_settings.holdoff < 0) {
+        // An arm that came in while we were at it stays, and
+        // starts over with fresh windows on the next call.
+        this->d_armed.clear_if(control);
+    } else {
+        d_holdoff_until = now + std::chrono::microseconds((long long) (d_settings.holdoff * 1e6));
+    }
+    // Hysteresis: every window has to come down before firing again.
+    if (d_settings.hysteresis > 0) {
+        for (size_t i = 0; i < d_windows.size(); i++) {
+            d_windows[i].ready = false;
+        }
+    }
+}
+
+void
+level_capture_trigger_impl::reset_windows() {
+    for (size_t i = 0; i < d_windows.size(); i++) {
+        d_windows[i].sum = 0;
+        d_windows[i].counter = 0;
+    }
+    d_history_count = 0;
+}
+
+/*
+* The trigger carries the absolute index of the first sample of the window
+* that fired, so a capture sink on another branch of the flowgraph can line
+* its capture up with it.
+*/
+void
+level_capture_trigger_impl::publish_trigger(int window, uint64_t last_sample, bool tag) {
+    const power_window& w = d_windows[window];
+    double average_power = w.sum / w.size;
+    uint64_t offset = last_sample + 1 >= w.size ? last_sample + 1 - w.size : 0;
+    pmt::pmt_t msg = pmt::make_dict();
+    msg = pmt::dict_add(msg, pmt::mp("trigger"), pmt::mp("start"));
+    msg = pmt::dict_add(msg, pmt::mp("offset"), pmt::from_uint64(offset));
+    msg = pmt::dict_add(msg, pmt::mp("window"), pmt::from_long(w.size));
+    msg = pmt::dict_add(msg, pmt::mp("power"), pmt::from_double(average_power));
+    message_port_pub(pmt::mp("trigger"),msg);
+    if (tag) {
+        // Tags can't go on items already produced, so mark the detection point.
+        add_item_tag(0, last_sample, pmt::mp("trigger"), pmt::from_uint64(offset));
+    }
+    GR_LOG_DEBUG(d_debug_logger,"level_capture_trigger::work pub window " + std::to_string(w.size) +
+                 " average_power " + std::to_string(average_power));
+}
+
+/*
+* Disjoint windows. The block is cut at the nearest window boundary so each
+* piece is summed once and added to every window.
+*/
+int
+level_capture_trigger_impl::detect_block(int start, int nblock, int& last, bool armed) {
+    int pos = start;
+    while (pos < nblock) {
+        size_t nsum = nblock - pos;
+        for (size_t i = 0; i < d_windows.size(); i++) {
+            nsum = std::min(nsum, d_windows[i].size - d_windows[i].counter);
+        }
+        float sum;
+        volk_32f_accumulator_s32f(&sum, d_power + pos, nsum);
+        pos += nsum;
+        int fired = -1;
+        for (size_t i = 0; i < d_windows.size(); i++) {
+            power_window& w = d_windows[i];
+            w.sum += sum;
+            w.counter += nsum;
+            if (w.counter == w.size) {
+#ifdef IQCAPTURE_DEBUG
+                GR_LOG_DEBUG(d_debug_logger,"level_capture_trigger::work average_power : " + std::to_string(w.sum / w.size)) ;
+#endif
+                if (w.sum < w.falling) {
+                    w.ready = true;
+                }
+                bool fire = fired < 0 && armed && w.ready && w.sum > w.threshold;
+                // The floor is compared before this window goes into it.
+                if (d_cfar) {
+                    add_noise(w);
+                }
+                if (fire) {
+                    fired = i;
+                } else {
+                    w.counter = 0;
+                    w.sum = 0;
+                }
+            }
+        }
+        if (fired >= 0) {
+            last = pos - 1;
+            return fired;
+        }
+    }
+    return -1;
 }
 
+/*
+* Windows that slide by one sample. Each window keeps a running sum: add the
+* new sample and subtract the one that just left, so the cost per sample is
+* constant. The sums are doubles, so the add/subtract round off stays far below
+* the power levels being compared.
+*/
+int
+level_capture_trigger_impl::detect_sliding(int start, int nblock, int& last, bool armed) {
+    for (int n = start; n < nblock; n++) {
+        float power = d_power[n];
+        d_history[d_history_count & d_history_mask] = power;
+        d_history_count++;
+        int fired = -1;
+        for (size_t i = 0; i < d_windows.size(); i++) {
+            power_window& w = d_windows[i];
+            w.sum += power;
+            w.counter++;
+            if (d_history_count > w.size) {
+                w.sum -= d_history[(d_history_count - 1 - w.size) & d_history_mask];
+            } else if (d_history_count < w.size) {
+                // Not a full window yet.
+                continue;
+            }
+            if (w.sum < w.falling) {
+                w.ready = true;
+            } else if (fired < 0 && armed && w.ready && w.sum > w.threshold) {
+                fired = i;
+            }
+            // Every size samples the window is disjoint from the last one
+            // that went into the noise floor.
+            if (w.counter == w.size) {
+                w.counter = 0;
+                if (d_cfar) {
+                    add_noise(w);
+                }
+            }
+        }
+        if (fired >= 0) {
+            // The other windows have this sample too, so we can go on
+            // from the next one.
+            last = n;
+            return fired;
+        }
+    }
+    return -1;
+}
 
 int
 level_capture_trigger_impl::general_work (int noutput_items,
@@ -114,48 +371,70 @@ level_capture_trigger_impl::general_work (int noutput_items,
 
 {
     const char *in = (const char *) input_items[0];
-    char *out = (char *) output_items[0];
     unsigned int byte_size = noutput_items * this->d_itemsize;
     this->d_itemcount = this->d_itemcount + noutput_items;
+    // With the output left unconnected this block is a pure sink and the
+    // stream is not copied.
+    bool pass_through = output_items.size() > 0;
 
     const gr_complex *input = (const gr_complex *) input_items[0];
 
-    static bool printDebug = true;
-
-
-    // Capture the window. Find the max power in the window.
-    // If this power exceeds a threshold then signal.
-    // GR_LOG_DEBUG(d_debug_logger,"level_capture_trigger::ninput_items " + std::to_string(noutput_items) + " itemsize " + std::to_string(d_itemsize) );
-
-    if (this->is_armed()) {
+    // Average the power over the windows. If the average exceeds the
+    // threshold then signal. Windows carry over from one call to the next.
+    // Pick up settings changed by the command handler.
+    if (d_policy.poll(d_settings, d_policy_seen)) {
+        apply_settings();
+    }
+    uint32_t control = this->d_armed.load();
+    bool armed = control_flag::is_set(control);
+    if (armed && control_flag::sequence(control) != d_arm_seen) {
+        // A new arm command: fire on the first window over the level.
+        for (size_t i = 0; i < d_windows.size(); i++) {
+            d_windows[i].ready = true;
+        }
+        d_holdoff_until = clock::time_point();
+    }
+    d_arm_seen = control_flag::sequence(control);
+    if (armed && holding_off(clock::now())) {
+        // Treated as disarmed, so the windows start fresh afterwards.
+        armed = false;
+    }
+    // In CFAR mode the noise floor is tracked while disarmed too.
+    if (armed || d_cfar) {
+        if (!d_was_armed) {
+            // Don't mix in power from before we were (re)armed.
+            reset_windows();
+        }
         // TODO-- this assumes float32 inputs.
-        for(int i = 0; i< noutput_items; i ++,input++) {
-            float ivalue = input->real();
-            float qvalue = input->imag();
-            float power = ivalue*ivalue + qvalue*qvalue;
-            this->d_power_in_window = d_power_in_window + power;
-            this->d_window_counter++ ;
-            if (this->d_window_counter == this->d_window_size) {
-                float average_power = d_power_in_window / d_window_size;
-#ifdef IQCAPTURE_DEBUG
-                GR_LOG_DEBUG(d_debug_logger,"level_capture_trigger::work average_power : " + std::to_string(average_power)) ;
-#endif
-                this->d_window_counter = 0;
-                this->d_power_in_window = 0;
-                if (average_power > d_level) {
-                    message_port_pub(pmt::mp("trigger"),pmt::intern(std::string("start")));
-                    GR_LOG_DEBUG(d_debug_logger,"level_capture_trigger::work pub" );
-                    // One shot behavior -- TODO make this configurable.
-                    this->disarm();
-                    break;
+        for (int offset = 0; offset < noutput_items; offset += POWER_BLOCK_SIZE) {
+            int nblock = std::min(POWER_BLOCK_SIZE, noutput_items - offset);
+            volk_32fc_magnitude_squared_32f(d_power, input + offset, nblock);
+            int start = 0;
+            int last = 0;
+            int fired;
+            while ((fired = d_mode == SLIDING ? detect_sliding(start, nblock, last, armed)
+                                              : detect_block(start, nblock, last, armed)) >= 0) {
+                publish_trigger(fired, nitems_read(0) + offset + last, pass_through);
+                if (d_mode == BLOCK) {
+                    // publish_trigger needed its sum; now it starts over.
+                    d_windows[fired].sum = 0;
+                    d_windows[fired].counter = 0;
                 }
-
+                after_trigger(control);
+                armed = false;
+                start = last + 1;
+            }
+            if (!armed && !d_cfar) {
+                break;
             }
         }
         this->d_logging_enabled = false;
     }
+    d_was_armed = armed || d_cfar;
 
-    memcpy(out,in,byte_size);
+    if (pass_through) {
+        memcpy(output_items[0],in,byte_size);
+    }
     consume_each (noutput_items);
     return noutput_items;
 }
@@ -22,27 +22,85 @@
 #define INCLUDED_MSOD_SENSOR_LEVEL_CAPTURE_TRIGGER_IMPL_H
 
 #include <msod_sensor/level_capture_trigger.h>
-#include <boost/interprocess/anonymous_shared_memory.hpp>
-#include <boost/interprocess/mapped_region.hpp>
+#include "control_flag.h"
+#include "trigger_policy.h"
+#include "running_min.h"
+#include <chrono>
+#include <deque>
 
 namespace gr {
   namespace msod_sensor {
 
+    // Running power sum for one window length.
+    struct power_window
+    {
+      size_t size;
+      double sum;
+      size_t counter;
+      // d_level * size, so the sum is compared without dividing.
+      double threshold;
+      // threshold less the hysteresis. The window must go below this
+      // after firing before it can fire again.
+      double falling;
+      bool ready;
+      // Noise floor in CFAR mode, from the sums of past disjoint windows.
+      running_min noise;
+    };
+
     class level_capture_trigger_impl : public level_capture_trigger
     {
      private:
+	enum Mode {BLOCK, SLIDING};
 	int d_itemcount;
 	int d_itemsize;
 	double d_level;
-	size_t d_window_size;
+	int d_mode;
 	bool d_logging_enabled;
-	float d_power_in_window;
-	int d_window_counter;
+	// Armed, or tracking the noise floor, on the last call.
+	bool d_was_armed;
+	// CFAR mode: threshold is d_cfar_ratio times the noise floor.
+	bool d_cfar;
+	double d_cfar_ratio;
+	// falling / threshold (the hysteresis).
+	double d_falling_ratio;
+	std::vector<power_window> d_windows;
+	// |x|^2 of the current block of input (volk aligned).
+	float* d_power;
+	// Per sample power history for the sliding windows.
+	std::vector<float> d_history;
+	size_t d_history_mask;
+	uint64_t d_history_count;
 
-        boost::interprocess::mapped_region  * d_armed;
+	void reset_windows();
+	// Go on from position start of the block. Return the index of the
+	// window that fired or -1. last is set to the position in the block
+	// of the sample that completed that window. Nothing fires unless armed.
+	int detect_block(int start, int nblock, int& last, bool armed);
+	int detect_sliding(int start, int nblock, int& last, bool armed);
+	void update_threshold(power_window& w);
+	void add_noise(power_window& w);
+	void publish_trigger(int window, uint64_t last_sample, bool tag);
+
+        // Shared with the command handler process that arms us.
+        control_flag d_armed;
+        // Sequence number of the arm flag last seen by work().
+        uint32_t d_arm_seen;
+        // Re-arm, hysteresis and rate settings, also set from that process.
+        trigger_policy d_policy;
+        trigger_settings d_settings;
+        uint32_t d_policy_seen;
+        typedef std::chrono::steady_clock clock;
+        clock::time_point d_holdoff_until;
+        // When the trigger fired in the last minute.
+        std::deque<clock::time_point> d_fired;
+
+        void apply_settings();
+        bool holding_off(clock::time_point now);
+        void after_trigger(uint32_t control);
 	
      public:
-      level_capture_trigger_impl(size_t itemsize, int level,size_t window_size);
+      level_capture_trigger_impl(size_t itemsize, int level,size_t window_size, int mode,
+                                 const std::vector<unsigned int> &window_sizes);
       ~level_capture_trigger_impl();
        // Where all the action really happens
       void forecast (int noutput_items, gr_vector_int &ninput_items_required);
@@ -58,6 +116,8 @@ namespace gr {
 	
       bool is_armed();
 
+      void set_trigger_params(char* params);
+
     };
 
   } // namespace msod_sensor
@@ -0,0 +1,283 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <map>
+#include <vector>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <algorithm>
+#include <boost/weak_ptr.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include "metadata_writer.h"
+
+namespace gr {
+namespace msod_sensor {
+
+// Writers in use, by backend and port or file name.
+static gr::thread::mutex s_writers_mutex;
+static std::map<std::pair<int, std::string>, boost::weak_ptr<metadata_writer> > s_writers;
+
+metadata_writer::sptr
+metadata_writer::get(int mongodb_port)
+{
+    return get(BACKEND_MONGO, std::to_string(mongodb_port));
+}
+
+metadata_writer::sptr
+metadata_writer::get(int backend, const std::string& target)
+{
+    if (backend != BACKEND_MONGO && backend != BACKEND_JSONL && backend != BACKEND_NONE) {
+        throw std::invalid_argument("metadata_writer: unknown backend " + std::to_string(backend));
+    }
+    std::pair<int, std::string> key(backend, backend == BACKEND_NONE ? std::string() : target);
+    gr::thread::scoped_lock guard(s_writers_mutex);
+    sptr writer = s_writers[key].lock();
+    if (!writer) {
+        writer = sptr(new metadata_writer(backend, key.second));
+        s_writers[key] = writer;
+    }
+    return writer;
+}
+
+metadata_writer::metadata_writer(int backend, const std::string& target)
+{
+    d_backend = backend;
+    d_conn = NULL;
+    d_fd = -1;
+    d_acknowledged = true;
+    d_inflight = 0;
+    d_dropped = 0;
+    d_failing = false;
+    d_done = false;
+    d_thread = NULL;
+    if (backend == BACKEND_NONE) {
+        return;
+    }
+    if (backend == BACKEND_MONGO) {
+        d_host = std::string("127.0.0.1:") + target;
+    } else {
+        d_fd = open(target.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (d_fd < 0) {
+            throw std::runtime_error("metadata_writer: cannot open " + target + ": " + strerror(errno));
+        }
+    }
+    d_thread = new gr::thread::thread(boost::bind(&metadata_writer::run, this));
+}
+
+metadata_writer::~metadata_writer()
+{
+    {
+        gr::thread::scoped_lock guard(d_mutex);
+        d_done = true;
+        d_cond.notify_all();
+    }
+    // The thread inserts what is queued before it exits (if mongod is there).
+    if (d_thread != NULL) {
+        d_thread->join();
+        delete d_thread;
+    }
+    delete d_conn;
+    if (d_fd >= 0) {
+        close(d_fd);
+    }
+}
+
+bool
+metadata_writer::connect(std::string& errmsg) {
+    delete d_conn;
+    d_conn = new mongo::DBClientConnection();
+    try {
+        if (d_conn->connect(d_host, errmsg)) {
+            return true;
+        }
+    } catch (mongo::DBException& e) {
+        errmsg = e.what();
+    }
+    delete d_conn;
+    d_conn = NULL;
+    return false;
+}
+
+/**
+* Store one batch of documents for collection ns.
+*/
+bool
+metadata_writer::write(const std::string& ns, const std::vector<mongo::BSONObj>& docs,
+                       const mongo::WriteConcern* concern, std::string& errmsg) {
+    if (d_backend == BACKEND_JSONL) {
+        std::string lines;
+        for (size_t i = 0; i < docs.size(); i++) {
+            mongo::BSONObjBuilder builder;
+            lines += builder.append("_ns", ns).appendElements(docs[i]).obj().jsonString();
+            lines += '\n';
+        }
+        // One write per batch, so concurrent readers never see half a batch.
+        const char* p = lines.data();
+        size_t left = lines.size();
+        while (left > 0) {
+            ssize_t n = ::write(d_fd, p, left);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                errmsg = std::string("write: ") + strerror(errno);
+                return false;
+            }
+            p += n;
+            left -= n;
+        }
+        return true;
+    }
+    if (d_conn == NULL && !connect(errmsg)) {
+        return false;
+    }
+    try {
+        d_conn->insert(ns, docs, 0, concern);
+        return true;
+    } catch (mongo::DBException& e) {
+        errmsg = e.what();
+        // Drop the connection; the next round makes a new one.
+        delete d_conn;
+        d_conn = NULL;
+        return false;
+    }
+}
+
+void
+metadata_writer::insert(const std::string& ns, const mongo::BSONObj& doc) {
+    if (d_backend == BACKEND_NONE) {
+        return;
+    }
+    gr::thread::scoped_lock guard(d_mutex);
+    if (d_queue.size() >= MAX_QUEUE) {
+        d_queue.pop_front();
+        d_dropped++;
+    }
+    d_queue.push_back(std::make_pair(ns, doc.getOwned()));
+    d_cond.notify_one();
+}
+
+void
+metadata_writer::set_acknowledged(bool acknowledged) {
+    gr::thread::scoped_lock guard(d_mutex);
+    d_acknowledged = acknowledged;
+}
+
+bool
+metadata_writer::flush(double timeout) {
+    gr::thread::scoped_lock guard(d_mutex);
+    boost::system_time deadline = boost::get_system_time() + boost::posix_time::milliseconds((long) (timeout * 1000));
+    while (!d_queue.empty() || d_inflight > 0) {
+        if (d_failing || !d_drained.timed_wait(guard, deadline)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t
+metadata_writer::pending() {
+    gr::thread::scoped_lock guard(d_mutex);
+    return d_queue.size() + d_inflight;
+}
+
+size_t
+metadata_writer::dropped() {
+    gr::thread::scoped_lock guard(d_mutex);
+    return d_dropped;
+}
+
+std::string
+metadata_writer::last_error() {
+    gr::thread::scoped_lock guard(d_mutex);
+    return d_error;
+}
+
+/**
+* Writer thread. Takes up to MAX_BATCH queued documents for one collection and
+* stores them with a single call, reconnecting with backoff when that fails.
+*/
+void
+metadata_writer::run() {
+    gr::thread::scoped_lock guard(d_mutex);
+    double backoff = 0;
+    while (true) {
+        while (d_queue.empty() && !d_done) {
+            d_cond.wait(guard);
+        }
+        // Stop once drained, or right away if mongod is not there to drain to.
+        if (d_done && (d_queue.empty() || backoff > 0)) {
+            d_drained.notify_all();
+            return;
+        }
+        std::string ns = d_queue.front().first;
+        std::vector<mongo::BSONObj> docs;
+        while (!d_queue.empty() && docs.size() < MAX_BATCH && d_queue.front().first == ns) {
+            docs.push_back(d_queue.front().second);
+            d_queue.pop_front();
+        }
+        d_inflight = docs.size();
+        const mongo::WriteConcern* concern = d_acknowledged ? &mongo::WriteConcern::acknowledged
+                                                            : &mongo::WriteConcern::unacknowledged;
+        guard.unlock();
+
+        std::string errmsg;
+        bool ok = write(ns, docs, concern, errmsg);
+
+        guard.lock();
+        d_inflight = 0;
+        d_failing = !ok;
+        if (ok) {
+            backoff = 0;
+        } else {
+            d_error = errmsg;
+            // Put the documents back in front, in order, and wait before retrying.
+            for (size_t i = docs.size(); i > 0; i--) {
+                d_queue.push_front(std::make_pair(ns, docs[i - 1]));
+            }
+            while (d_queue.size() > MAX_QUEUE) {
+                d_queue.pop_front();
+                d_dropped++;
+            }
+            backoff = backoff == 0 ? 0.5 : std::min(2 * backoff, 30.0);
+            // Nothing will drain for a while; don't keep flush() waiting.
+            d_drained.notify_all();
+            // New records wake d_cond too, so wait for the deadline itself.
+            // Only stopping cuts the wait short.
+            boost::system_time retry = boost::get_system_time() + boost::posix_time::milliseconds((long) (backoff * 1000));
+            while (!d_done && boost::get_system_time() < retry) {
+                d_cond.timed_wait(guard, retry);
+            }
+        }
+        if (d_queue.empty()) {
+            d_drained.notify_all();
+        }
+    }
+}
+
+} /* namespace msod_sensor */
+} /* namespace gr */
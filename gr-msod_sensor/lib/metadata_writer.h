@@ -0,0 +1,122 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_MSOD_SENSOR_METADATA_WRITER_H
+#define INCLUDED_MSOD_SENSOR_METADATA_WRITER_H
+
+#include <string>
+#include <deque>
+#include <vector>
+#include <utility>
+#include <boost/shared_ptr.hpp>
+#include <mongo/client/dbclient.h>
+#include <mongo/bson/bson.h>
+#include <gnuradio/thread/thread.h>
+
+namespace gr {
+  namespace msod_sensor {
+
+    /*!
+     * Stores capture records from a background thread, so a slow or busy
+     * database never holds up the flowgraph.
+     *
+     * The records go to one of these backends:
+     *  - BACKEND_MONGO inserts them into the local mongod, in bulk, up to
+     *    MAX_BATCH per round trip. The connection is made lazily by the
+     *    writer thread; if mongod is not up yet (or goes away) the writer
+     *    keeps the records, reconnects with backoff and carries on.
+     *  - BACKEND_JSONL appends them to a local file, one JSON document
+     *    per line, with the collection name in an "_ns" field.
+     *  - BACKEND_NONE discards them.
+     *
+     * The queue is bounded; when it is full the oldest records are
+     * dropped. One writer (one thread, one connection or file) is shared
+     * by all the sinks using the same port or file.
+     */
+    class metadata_writer
+    {
+     public:
+      typedef boost::shared_ptr<metadata_writer> sptr;
+
+      enum backend_t {
+        BACKEND_MONGO = 0,
+        BACKEND_JSONL = 1,
+        BACKEND_NONE = 2
+      };
+
+      // The mongod writer for this port, created on first use. Does not
+      // wait for mongod; the first insert connects.
+      static sptr get(int mongodb_port);
+
+      // The writer for any backend. target is the port number for
+      // BACKEND_MONGO and the file name for BACKEND_JSONL. Throws if
+      // the file cannot be opened.
+      static sptr get(int backend, const std::string& target);
+
+      ~metadata_writer();
+
+      // Queue a document for insertion into the collection ns.
+      void insert(const std::string& ns, const mongo::BSONObj& doc);
+
+      // Wait for an acknowledgement of each bulk insert (the default), or not.
+      void set_acknowledged(bool acknowledged);
+
+      // Wait up to timeout seconds for the queue to drain. False on
+      // timeout, or as soon as a write fails (mongod not there): nothing
+      // drains until the backoff is over.
+      bool flush(double timeout);
+
+      size_t pending();
+      size_t dropped();
+      std::string last_error();
+
+     private:
+      static const size_t MAX_BATCH = 256;
+      static const size_t MAX_QUEUE = 16384;
+
+      int d_backend;
+      std::string d_host;
+      mongo::DBClientConnection* d_conn;
+      int d_fd;
+      std::string d_error;
+      bool   d_acknowledged;
+      std::deque<std::pair<std::string, mongo::BSONObj> > d_queue;
+      size_t d_inflight;
+      size_t d_dropped;
+      // The last write failed; the writer is backing off.
+      bool   d_failing;
+
+      gr::thread::mutex d_mutex;
+      gr::thread::condition_variable d_cond;
+      gr::thread::condition_variable d_drained;
+      gr::thread::thread* d_thread;
+      bool   d_done;
+
+      metadata_writer(int backend, const std::string& target);
+      bool connect(std::string& errmsg);
+      bool write(const std::string& ns, const std::vector<mongo::BSONObj>& docs,
+                 const mongo::WriteConcern* concern, std::string& errmsg);
+      void run();
+    };
+
+  } // namespace msod_sensor
+} // namespace gr
+
+#endif /* INCLUDED_MSOD_SENSOR_METADATA_WRITER_H */
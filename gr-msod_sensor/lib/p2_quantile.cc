@@ -0,0 +1,131 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <algorithm>
+#include <math.h>
+#include "p2_quantile.h"
+
+namespace gr {
+namespace msod_sensor {
+
+p2_quantile::p2_quantile()
+{
+    reset(0.5);
+}
+
+void
+p2_quantile::reset(float p)
+{
+    d_p = p;
+    d_n = 0;
+    for (int i = 0; i < 5; i++) {
+        d_pos[i] = i;
+    }
+    d_want[0] = 0;
+    d_want[1] = 2 * p;
+    d_want[2] = 4 * p;
+    d_want[3] = 2 + 2 * p;
+    d_want[4] = 4;
+    d_step[0] = 0;
+    d_step[1] = p / 2;
+    d_step[2] = p;
+    d_step[3] = (1 + p) / 2;
+    d_step[4] = 1;
+}
+
+float
+p2_quantile::parabolic(int i, int s) const
+{
+    return d_q[i] + s / (d_pos[i + 1] - d_pos[i - 1])
+           * ((d_pos[i] - d_pos[i - 1] + s) * (d_q[i + 1] - d_q[i]) / (d_pos[i + 1] - d_pos[i])
+              + (d_pos[i + 1] - d_pos[i] - s) * (d_q[i] - d_q[i - 1]) / (d_pos[i] - d_pos[i - 1]));
+}
+
+float
+p2_quantile::linear(int i, int s) const
+{
+    return d_q[i] + s * (d_q[i + s] - d_q[i]) / (d_pos[i + s] - d_pos[i]);
+}
+
+void
+p2_quantile::add(float x)
+{
+    if (d_n < 5) {
+        d_q[d_n++] = x;
+        if (d_n == 5) {
+            std::sort(d_q, d_q + 5);
+        }
+        return;
+    }
+    // Find the cell the value falls in, stretching the end markers if needed.
+    int k;
+    if (x < d_q[0]) {
+        d_q[0] = x;
+        k = 0;
+    } else if (x >= d_q[4]) {
+        d_q[4] = x;
+        k = 3;
+    } else {
+        k = 0;
+        while (x >= d_q[k + 1]) {
+            k++;
+        }
+    }
+    for (int i = k + 1; i < 5; i++) {
+        d_pos[i]++;
+    }
+    for (int i = 0; i < 5; i++) {
+        d_want[i] += d_step[i];
+    }
+    // Move the middle markers towards where they should be.
+    for (int i = 1; i < 4; i++) {
+        double d = d_want[i] - d_pos[i];
+        if ((d >= 1 && d_pos[i + 1] - d_pos[i] > 1) || (d <= -1 && d_pos[i - 1] - d_pos[i] < -1)) {
+            int s = d > 0 ? 1 : -1;
+            float q = parabolic(i, s);
+            d_q[i] = (d_q[i - 1] < q && q < d_q[i + 1]) ? q : linear(i, s);
+            d_pos[i] += s;
+        }
+    }
+    d_n++;
+}
+
+float
+p2_quantile::value() const
+{
+    if (d_n >= 5) {
+        return d_q[2];
+    }
+    if (d_n == 0) {
+        return 0;
+    }
+    float sorted[5];
+    std::copy(d_q, d_q + d_n, sorted);
+    std::sort(sorted, sorted + d_n);
+    return sorted[(int) lroundf(d_p * (d_n - 1))];
+}
+
+} /* namespace msod_sensor */
+} /* namespace gr */
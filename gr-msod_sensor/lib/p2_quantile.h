@@ -0,0 +1,60 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef INCLUDED_MSOD_SENSOR_P2_QUANTILE_H
+#define INCLUDED_MSOD_SENSOR_P2_QUANTILE_H
+
+namespace gr {
+  namespace msod_sensor {
+
+    /*!
+     * Streaming estimate of one quantile with the P^2 algorithm (Jain and
+     * Chlamtac, 1985): five markers whose heights are adjusted with a
+     * piecewise parabolic fit as values arrive. Constant memory, no
+     * sorting once the first five values are in.
+     */
+    class p2_quantile
+    {
+     public:
+      p2_quantile();
+
+      // Start over, estimating the p quantile (0 < p < 1).
+      void reset(float p);
+      void add(float x);
+      // The estimate so far (exact while fewer than five values were added).
+      float value() const;
+
+     private:
+      float  d_p;
+      int    d_n;
+      float  d_q[5];      // marker heights
+      double d_pos[5];    // marker positions
+      double d_want[5];   // desired marker positions
+      double d_step[5];   // increment of the desired positions
+
+      float parabolic(int i, int s) const;
+      float linear(int i, int s) const;
+    };
+
+  } // namespace msod_sensor
+} // namespace gr
+
+#endif /* INCLUDED_MSOD_SENSOR_P2_QUANTILE_H */
@@ -0,0 +1,54 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <algorithm>
+#include <volk/volk.h>
+#include "power_db.h"
+
+namespace gr {
+namespace msod_sensor {
+
+void
+power_to_log2(float* out, const float* in, unsigned int n)
+{
+    for (unsigned int i = 0; i < n; i++) {
+        out[i] = std::max(in[i], 1e-18f);
+    }
+    volk_32f_log2_32f(out, out, n);
+}
+
+void
+power_to_db(float* out, const float* in, unsigned int n, float offset_db)
+{
+    // 10 log10(x) = 10 log10(2) * log2(x)
+    const float db_per_octave = 3.0102999566f;
+    power_to_log2(out, in, n);
+    for (unsigned int i = 0; i < n; i++) {
+        out[i] = out[i] * db_per_octave + offset_db;
+    }
+}
+
+} /* namespace msod_sensor */
+} /* namespace gr */
@@ -0,0 +1,43 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef INCLUDED_MSOD_SENSOR_POWER_DB_H
+#define INCLUDED_MSOD_SENSOR_POWER_DB_H
+
+namespace gr {
+  namespace msod_sensor {
+
+    /*!
+     * out[i] = 10 log10(max(in[i], 1e-18)) + offset_db, as nlog10_ff does,
+     * but with the VOLK log2 kernel. out may be in.
+     */
+    void power_to_db(float* out, const float* in, unsigned int n, float offset_db);
+
+    /*!
+     * out[i] = log2(max(in[i], 1e-18)), the part of power_to_db that
+     * averages in the log domain need. out may be in.
+     */
+    void power_to_log2(float* out, const float* in, unsigned int n);
+
+  } // namespace msod_sensor
+} // namespace gr
+
+#endif /* INCLUDED_MSOD_SENSOR_POWER_DB_H */
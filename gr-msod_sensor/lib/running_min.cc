@@ -0,0 +1,72 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <algorithm>
+#include "running_min.h"
+
+namespace gr {
+namespace msod_sensor {
+
+running_min::running_min(size_t length)
+{
+    reset(length);
+}
+
+void
+running_min::reset(size_t length)
+{
+    d_length = std::max((size_t) 1, length);
+    d_count = 0;
+    d_candidates.clear();
+}
+
+void
+running_min::add(double x)
+{
+    // Older values that are no smaller can never be the minimum again.
+    while (!d_candidates.empty() && d_candidates.back().second >= x) {
+        d_candidates.pop_back();
+    }
+    d_candidates.push_back(std::make_pair(d_count, x));
+    d_count++;
+    if (d_candidates.front().first + d_length < d_count) {
+        d_candidates.pop_front();
+    }
+}
+
+double
+running_min::value() const
+{
+    return d_candidates.empty() ? 0 : d_candidates.front().second;
+}
+
+bool
+running_min::full() const
+{
+    return d_count >= d_length;
+}
+
+} /* namespace msod_sensor */
+} /* namespace gr */
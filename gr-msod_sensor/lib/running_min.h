@@ -0,0 +1,62 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef INCLUDED_MSOD_SENSOR_RUNNING_MIN_H
+#define INCLUDED_MSOD_SENSOR_RUNNING_MIN_H
+
+#include <deque>
+#include <utility>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace gr {
+  namespace msod_sensor {
+
+    /*!
+     * Minimum of the last length values (minimum statistics noise
+     * estimate). Keeps the values that can still become the minimum in
+     * increasing order, so an add is amortized O(1) and value() is O(1).
+     */
+    class running_min
+    {
+     public:
+      running_min(size_t length = 1);
+
+      // Forget all values and look at the last length from now on.
+      void reset(size_t length);
+      void add(double x);
+      // Minimum of the last length values (of all so far while not full).
+      double value() const;
+      // True once length values were added.
+      bool full() const;
+      size_t length() const { return d_length; }
+
+     private:
+      size_t d_length;
+      uint64_t d_count;
+      // (index, value), values increasing from the front.
+      std::deque<std::pair<uint64_t, double> > d_candidates;
+    };
+
+  } // namespace msod_sensor
+} // namespace gr
+
+#endif /* INCLUDED_MSOD_SENSOR_RUNNING_MIN_H */
@@ -0,0 +1,89 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <time.h>
+#include <math.h>
+#include <pmt/pmt.h>
+#include "sample_clock.h"
+
+namespace gr {
+namespace msod_sensor {
+
+sample_clock::sample_clock(double samp_rate)
+{
+    d_samp_rate = samp_rate;
+    d_have_ref = false;
+    d_from_device = false;
+    d_ref_sample = 0;
+    d_ref_ns = 0;
+}
+
+void
+sample_clock::handle_tags(const std::vector<tag_t> &tags) {
+    static const pmt::pmt_t RX_TIME = pmt::mp("rx_time");
+    static const pmt::pmt_t RX_RATE = pmt::mp("rx_rate");
+    for (size_t i = 0; i < tags.size(); i++) {
+        const tag_t &tag = tags[i];
+        if (pmt::eq(tag.key, RX_TIME)) {
+            // (uint64 full seconds, double fractional seconds)
+            uint64_t secs = pmt::to_uint64(pmt::tuple_ref(tag.value, 0));
+            double frac = pmt::to_double(pmt::tuple_ref(tag.value, 1));
+            d_ref_sample = tag.offset;
+            d_ref_ns = (int64_t) secs * 1000000000LL + (int64_t) llround(frac * 1e9);
+            d_have_ref = true;
+            d_from_device = true;
+        } else if (pmt::eq(tag.key, RX_RATE)) {
+            d_samp_rate = pmt::to_double(tag.value);
+        }
+    }
+}
+
+void
+sample_clock::anchor(uint64_t sample) {
+    if (!d_have_ref) {
+        d_ref_sample = sample;
+        d_ref_ns = host_time_ns();
+        d_have_ref = true;
+    }
+}
+
+int64_t
+sample_clock::time_ns(uint64_t sample) const {
+    if (!valid()) {
+        return 0;
+    }
+    // Signed, a sample can come before the reference (e.g. pre-trigger history).
+    double delta = (double) ((int64_t) (sample - d_ref_sample));
+    return d_ref_ns + (int64_t) llround(delta * 1e9 / d_samp_rate);
+}
+
+int64_t
+sample_clock::host_time_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+} /* namespace msod_sensor */
+} /* namespace gr */
@@ -0,0 +1,72 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_MSOD_SENSOR_SAMPLE_CLOCK_H
+#define INCLUDED_MSOD_SENSOR_SAMPLE_CLOCK_H
+
+#include <stdint.h>
+#include <vector>
+#include <gnuradio/tags.h>
+
+namespace gr {
+  namespace msod_sensor {
+
+    /*!
+     * Maps absolute sample indices (nitems_read) to wall-clock time.
+     *
+     * The reference point comes from the UHD "rx_time" tag when the source
+     * provides one ("rx_rate" updates the sample rate). Otherwise the host
+     * clock is read once, at the first sample seen, and the sample rate
+     * is used from there on. Times are nanoseconds since the Unix epoch.
+     */
+    class sample_clock
+    {
+     private:
+      double   d_samp_rate;
+      bool     d_have_ref;
+      bool     d_from_device;
+      uint64_t d_ref_sample;
+      int64_t  d_ref_ns;
+
+     public:
+      sample_clock(double samp_rate);
+
+      // Pick up "rx_time" and "rx_rate" tags from one work() call.
+      void handle_tags(const std::vector<tag_t> &tags);
+
+      // Anchor to the host clock at this sample if no reference is set yet.
+      void anchor(uint64_t sample);
+
+      bool valid() const { return d_have_ref && d_samp_rate > 0; }
+      // True if the reference came from an rx_time tag.
+      bool from_device() const { return d_from_device; }
+      double samp_rate() const { return d_samp_rate; }
+
+      // Wall-clock time of the given sample (0 if there is no reference).
+      int64_t time_ns(uint64_t sample) const;
+
+      // Current host time in nanoseconds since the epoch.
+      static int64_t host_time_ns();
+    };
+
+  } // namespace msod_sensor
+} // namespace gr
+
+#endif /* INCLUDED_MSOD_SENSOR_SAMPLE_CLOCK_H */
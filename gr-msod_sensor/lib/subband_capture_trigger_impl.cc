@@ -0,0 +1,222 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <stdexcept>
+#include <gnuradio/io_signature.h>
+#include <pmt/pmt.h>
+#include "subband_capture_trigger_impl.h"
+
+namespace gr {
+namespace msod_sensor {
+
+subband_capture_trigger::sptr
+subband_capture_trigger::make(unsigned int vlen, const std::vector<unsigned int> &channels,
+                              const std::vector<float> &thresholds, size_t samples_per_vector,
+                              float floor_alpha, unsigned int warmup,
+                              unsigned int floor_window)
+{
+    return gnuradio::get_initial_sptr
+           (new subband_capture_trigger_impl(vlen, channels, thresholds, samples_per_vector,
+                                             floor_alpha, warmup, floor_window));
+}
+
+/*
+ * The private constructor
+ */
+subband_capture_trigger_impl::subband_capture_trigger_impl(unsigned int vlen, const std::vector<unsigned int> &channels,
+        const std::vector<float> &thresholds, size_t samples_per_vector,
+        float floor_alpha, unsigned int warmup,
+        unsigned int floor_window)
+    : gr::sync_block("subband_capture_trigger",
+                     gr::io_signature::make(1, 1, vlen * sizeof(float)),
+                     gr::io_signature::make(0, 1, vlen * sizeof(float))),
+    d_vlen(vlen),
+    d_samples_per_vector(samples_per_vector),
+    d_floor_alpha(floor_alpha),
+    d_warmup(std::max(1u, warmup)),
+    d_seen(0)
+{
+    if (floor_alpha <= 0 || floor_alpha > 1) {
+        throw std::invalid_argument("subband_capture_trigger: floor_alpha must be in (0, 1]");
+    }
+    if (floor_window == 0) {
+        throw std::invalid_argument("subband_capture_trigger: floor_window must be positive");
+    }
+    if (channels.empty()) {
+        for (unsigned int i = 0; i < vlen; i++) {
+            d_channels.push_back(i);
+        }
+    } else {
+        d_channels = channels;
+    }
+    for (size_t i = 0; i < d_channels.size(); i++) {
+        if (d_channels[i] >= vlen) {
+            throw std::invalid_argument("subband_capture_trigger: channel " + std::to_string(d_channels[i]) +
+                                        " is outside the vector");
+        }
+    }
+    d_power.assign(d_channels.size(), 0);
+    d_floor_min.assign(d_channels.size(), running_min(floor_window));
+    d_floor.assign(d_channels.size(), 0);
+    set_thresholds(thresholds);
+    message_port_register_out(pmt::mp("trigger"));
+}
+
+/*
+ * Our virtual destructor.
+ */
+subband_capture_trigger_impl::~subband_capture_trigger_impl()
+{
+}
+
+bool
+subband_capture_trigger_impl::is_armed() {
+    return this->d_armed.test();
+}
+
+void
+subband_capture_trigger_impl::arm() {
+    this->d_armed.set();
+    GR_LOG_DEBUG(d_debug_logger,"subband_capture_trigger::arm");
+}
+
+void
+subband_capture_trigger_impl::disarm() {
+    GR_LOG_DEBUG(d_debug_logger,"subband_capture_trigger::disarm");
+    this->d_armed.clear();
+}
+
+void
+subband_capture_trigger_impl::set_thresholds(const std::vector<float> &thresholds) {
+    if (thresholds.size() != 1 && thresholds.size() != d_channels.size()) {
+        throw std::invalid_argument("subband_capture_trigger: need one threshold, or one per channel");
+    }
+    gr::thread::scoped_lock guard(d_mutex);
+    d_ratio.resize(d_channels.size());
+    for (size_t i = 0; i < d_channels.size(); i++) {
+        float db = thresholds.size() == 1 ? thresholds[0] : thresholds[i];
+        d_ratio[i] = pow(10.0, db / 10.0);
+    }
+}
+
+std::vector<float>
+subband_capture_trigger_impl::noise_floor() {
+    gr::thread::scoped_lock guard(d_mutex);
+    std::vector<float> floor_db(d_floor.size());
+    for (size_t i = 0; i < d_floor.size(); i++) {
+        floor_db[i] = 10.0 * log10(std::max(d_floor[i], 1e-20f));
+    }
+    return floor_db;
+}
+
+/*
+* Same message as level_capture_trigger, plus the channel that fired. The
+* offset is only there if we know where the vector sits in the I/Q stream.
+*/
+void
+subband_capture_trigger_impl::publish_trigger(int channel, float power, uint64_t vector, bool tag) {
+    pmt::pmt_t msg = pmt::make_dict();
+    msg = pmt::dict_add(msg, pmt::mp("trigger"), pmt::mp("start"));
+    if (d_samples_per_vector > 0) {
+        msg = pmt::dict_add(msg, pmt::mp("offset"), pmt::from_uint64(vector * d_samples_per_vector));
+        msg = pmt::dict_add(msg, pmt::mp("window"), pmt::from_long(d_samples_per_vector));
+    }
+    msg = pmt::dict_add(msg, pmt::mp("channel"), pmt::from_long(d_channels[channel]));
+    msg = pmt::dict_add(msg, pmt::mp("power"), pmt::from_double(power));
+    msg = pmt::dict_add(msg, pmt::mp("floor"), pmt::from_double(d_floor[channel]));
+    message_port_pub(pmt::mp("trigger"), msg);
+    if (tag) {
+        add_item_tag(0, vector, pmt::mp("trigger"), pmt::from_long(d_channels[channel]));
+    }
+    GR_LOG_DEBUG(d_debug_logger,"subband_capture_trigger::work pub channel " + std::to_string(d_channels[channel]) +
+                 " power " + std::to_string(power) + " floor " + std::to_string(d_floor[channel]));
+}
+
+/*
+* The floor of a channel is the minimum, over the last floor_window
+* vectors, of an exponential average of its power (minimum statistics).
+* A burst or a signal shorter than the window never shows in the floor;
+* one that stays on becomes the floor once it fills the window, so a rise
+* of the floor stops the trigger after at most floor_window vectors, plus
+* the few the average takes to settle. A fall is followed at once. The
+* estimate sits a little under the mean power of noise.
+*/
+int
+subband_capture_trigger_impl::work(int noutput_items,
+                                   gr_vector_const_void_star &input_items,
+                                   gr_vector_void_star &output_items)
+{
+    const float *in = (const float *) input_items[0];
+    bool pass_through = output_items.size() > 0;
+    uint32_t control = this->d_armed.load();
+    bool armed = control_flag::is_set(control);
+
+    gr::thread::scoped_lock guard(d_mutex);
+    size_t nchannels = d_channels.size();
+    for (int n = 0; n < noutput_items; n++) {
+        const float* vec = in + (size_t) n * d_vlen;
+        if (d_seen < d_warmup) {
+            // Plain mean until the average has settled.
+            d_seen++;
+            for (size_t c = 0; c < nchannels; c++) {
+                d_power[c] += (vec[d_channels[c]] - d_power[c]) / d_seen;
+                if (d_seen == d_warmup) {
+                    d_floor_min[c].add(d_power[c]);
+                    d_floor[c] = d_power[c];
+                }
+            }
+            continue;
+        }
+        int fired = -1;
+        for (size_t c = 0; c < nchannels; c++) {
+            float power = vec[d_channels[c]];
+            float limit = d_floor[c] * d_ratio[c];
+            if (armed && fired < 0 && power > limit) {
+                fired = c;
+                publish_trigger(c, power, nitems_read(0) + n, pass_through);
+            }
+            d_power[c] += d_floor_alpha * (power - d_power[c]);
+            d_floor_min[c].add(d_power[c]);
+            d_floor[c] = d_floor_min[c].value();
+        }
+        if (fired >= 0) {
+            // One shot, as level_capture_trigger. An arm that came in
+            // meanwhile stays.
+            this->d_armed.clear_if(control);
+            armed = false;
+        }
+    }
+
+    if (pass_through) {
+        memcpy(output_items[0], in, (size_t) noutput_items * d_vlen * sizeof(float));
+    }
+    return noutput_items;
+}
+
+} /* namespace msod_sensor */
+} /* namespace gr */
+
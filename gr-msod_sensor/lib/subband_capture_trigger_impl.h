@@ -0,0 +1,83 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_MSOD_SENSOR_SUBBAND_CAPTURE_TRIGGER_IMPL_H
+#define INCLUDED_MSOD_SENSOR_SUBBAND_CAPTURE_TRIGGER_IMPL_H
+
+#include <msod_sensor/subband_capture_trigger.h>
+#include <gnuradio/thread/thread.h>
+#include "control_flag.h"
+#include "running_min.h"
+
+namespace gr {
+  namespace msod_sensor {
+
+    class subband_capture_trigger_impl : public subband_capture_trigger
+    {
+     private:
+	unsigned int d_vlen;
+	size_t d_samples_per_vector;
+	float d_floor_alpha;
+	unsigned int d_warmup;
+	// Vectors seen so far, up to d_warmup.
+	unsigned int d_seen;
+	std::vector<unsigned int> d_channels;
+	// Threshold of each channel as a power ratio over its floor.
+	std::vector<float> d_ratio;
+	// Average power of each channel, and its minimum over the floor
+	// window, which is the noise floor (linear).
+	std::vector<float> d_power;
+	std::vector<running_min> d_floor_min;
+	std::vector<float> d_floor;
+	gr::thread::mutex d_mutex;
+
+        // Shared with the command handler process that arms us.
+        control_flag d_armed;
+
+	void publish_trigger(int channel, float power, uint64_t vector, bool tag);
+
+     public:
+      subband_capture_trigger_impl(unsigned int vlen, const std::vector<unsigned int> &channels,
+                                   const std::vector<float> &thresholds, size_t samples_per_vector,
+                                   float floor_alpha, unsigned int warmup,
+                                   unsigned int floor_window);
+      ~subband_capture_trigger_impl();
+
+      // Where all the action really happens
+      int work(int noutput_items,
+	       gr_vector_const_void_star &input_items,
+	       gr_vector_void_star &output_items);
+
+      void arm();
+
+      void disarm();
+
+      bool is_armed();
+
+      void set_thresholds(const std::vector<float> &thresholds);
+
+      std::vector<float> noise_floor();
+    };
+
+  } // namespace msod_sensor
+} // namespace gr
+
+#endif /* INCLUDED_MSOD_SENSOR_SUBBAND_CAPTURE_TRIGGER_IMPL_H */
+
@@ -67,8 +67,9 @@ threshold_timestamp_impl::work(int noutput_items,
                                gr_vector_const_void_star &input_items,
                                gr_vector_void_star &output_items)
 {
-    clock_t t;
+    struct timespec t;
     char s[100];
+    uint64_t nread = nitems_read(0);
     float value[noutput_items * d_vlen];
 
     if (d_type == 0) {
@@ -97,9 +98,10 @@ threshold_timestamp_impl::work(int noutput_items,
         }
         float metric = (d_type == 0) ? (d_prior / current) : (d_prior - current);
         if (metric > d_threshold) {
-            // write current time to file descriptor d_fd
-            t = clock();
-            sprintf(s, "%d clicks; %f s\n", t, ((float)t)/CLOCKS_PER_SEC);
+            // write the item index and the wall-clock time to file descriptor d_fd
+            clock_gettime(CLOCK_REALTIME, &t);
+            sprintf(s, "item %llu; %ld.%09ld s\n", (unsigned long long) (nread + n),
+                    (long) t.tv_sec, t.tv_nsec);
             write(d_fd, s, strlen(s));
         }
         d_prior = current;
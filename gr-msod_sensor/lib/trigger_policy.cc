@@ -0,0 +1,139 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <new>
+#include <algorithm>
+#include <stdexcept>
+#include <math.h>
+#include <mongo/bson/bson.h>
+#include <mongo/client/dbclient.h>
+#include "control_flag.h"
+#include "trigger_policy.h"
+
+namespace gr {
+namespace msod_sensor {
+
+trigger_policy::trigger_policy(const trigger_settings& initial)
+{
+    d_shared = new (map_shared(sizeof(shared))) shared();
+    d_shared->seq.store(0);
+    set(initial);
+}
+
+trigger_policy::~trigger_policy()
+{
+    unmap_shared(d_shared, sizeof(shared));
+}
+
+void
+trigger_policy::set(const trigger_settings& settings)
+{
+    // Odd while the fields are being written.
+    d_shared->seq.fetch_add(1, std::memory_order_acq_rel);
+    d_shared->level_mdb.store((int32_t) lround(settings.level * 1000), std::memory_order_relaxed);
+    d_shared->holdoff_ms.store(settings.holdoff < 0 ? -1 : (int32_t) lround(settings.holdoff * 1000),
+                               std::memory_order_relaxed);
+    d_shared->hysteresis_mdb.store((int32_t) lround(settings.hysteresis * 1000), std::memory_order_relaxed);
+    d_shared->max_per_minute.store(settings.max_per_minute, std::memory_order_relaxed);
+    d_shared->cfar_margin_mdb.store((int32_t) lround(settings.cfar_margin * 1000), std::memory_order_relaxed);
+    d_shared->cfar_windows.store(settings.cfar_windows, std::memory_order_relaxed);
+    d_shared->seq.fetch_add(1, std::memory_order_release);
+}
+
+trigger_settings
+trigger_policy::read() const
+{
+    trigger_settings settings;
+    settings.level = d_shared->level_mdb.load(std::memory_order_relaxed) / 1000.0;
+    int32_t holdoff = d_shared->holdoff_ms.load(std::memory_order_relaxed);
+    settings.holdoff = holdoff < 0 ? -1 : holdoff / 1000.0;
+    settings.hysteresis = d_shared->hysteresis_mdb.load(std::memory_order_relaxed) / 1000.0;
+    settings.max_per_minute = d_shared->max_per_minute.load(std::memory_order_relaxed);
+    settings.cfar_margin = d_shared->cfar_margin_mdb.load(std::memory_order_relaxed) / 1000.0;
+    settings.cfar_windows = d_shared->cfar_windows.load(std::memory_order_relaxed);
+    return settings;
+}
+
+trigger_settings
+trigger_policy::get() const
+{
+    trigger_settings settings;
+    uint32_t seen = ~0u;
+    while (!poll(settings, seen)) {
+        // A write is under way in another process; it is only a few stores.
+    }
+    return settings;
+}
+
+bool
+trigger_policy::poll(trigger_settings& settings, uint32_t& seen) const
+{
+    uint32_t seq = d_shared->seq.load(std::memory_order_acquire);
+    if (seq == seen || (seq & 1)) {
+        return false;
+    }
+    trigger_settings copy = read();
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (d_shared->seq.load(std::memory_order_relaxed) != seq) {
+        return false;
+    }
+    settings = copy;
+    seen = seq;
+    return true;
+}
+
+void
+trigger_policy::set_json(const std::string& json)
+{
+    mongo::BSONObj params;
+    try {
+        params = mongo::fromjson(json);
+    } catch (std::exception& e) {
+        throw std::invalid_argument(std::string("trigger params: ") + e.what());
+    }
+    trigger_settings settings = get();
+    if (params["level"].isNumber()) {
+        settings.level = params["level"].numberDouble();
+    }
+    if (params["holdoff"].isNumber()) {
+        settings.holdoff = params["holdoff"].numberDouble();
+    }
+    if (params["hysteresis"].isNumber()) {
+        settings.hysteresis = params["hysteresis"].numberDouble();
+    }
+    if (params["maxPerMinute"].isNumber()) {
+        settings.max_per_minute = (int) params["maxPerMinute"].numberDouble();
+    }
+    if (params["cfarMargin"].isNumber()) {
+        settings.cfar_margin = params["cfarMargin"].numberDouble();
+    }
+    if (params["cfarWindows"].isNumber()) {
+        settings.cfar_windows = std::max(1, (int) params["cfarWindows"].numberDouble());
+    }
+    set(settings);
+}
+
+} /* namespace msod_sensor */
+} /* namespace gr */
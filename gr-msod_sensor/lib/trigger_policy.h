@@ -0,0 +1,99 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef INCLUDED_MSOD_SENSOR_TRIGGER_POLICY_H
+#define INCLUDED_MSOD_SENSOR_TRIGGER_POLICY_H
+
+#include <atomic>
+#include <string>
+#include <stdint.h>
+
+namespace gr {
+  namespace msod_sensor {
+
+    // What a trigger does once armed.
+    struct trigger_settings
+    {
+      // Fire when the window power rises above this (dBm).
+      double level;
+      // < 0: one shot, disarm after firing (the default). Otherwise stay
+      // armed and start looking again this many seconds after firing.
+      double holdoff;
+      // If > 0, after firing the power must drop this many dB below level
+      // before the trigger can fire again.
+      double hysteresis;
+      // At most this many triggers in any 60 s (0 for no limit).
+      int max_per_minute;
+      // If > 0, ignore level and fire this many dB above the noise
+      // floor, the lowest window power of the last cfar_windows windows.
+      double cfar_margin;
+      int cfar_windows;
+    };
+
+    /*!
+     * Trigger settings shared with forked processes.
+     *
+     * The command handler of sslsocket_sink runs in a child process and
+     * sets these from the setTriggerParams JSON of an arm command, so
+     * they live in an anonymous shared page like control_flag. Writes
+     * are published with a sequence lock; work() polls the sequence
+     * number and only copies the settings out when it changed.
+     */
+    class trigger_policy
+    {
+     public:
+      trigger_policy(const trigger_settings& initial);
+      ~trigger_policy();
+
+      void set(const trigger_settings& settings);
+      trigger_settings get() const;
+
+      // Update from a JSON object. Recognized keys: "level" (dBm),
+      // "holdoff" (s, negative for one shot), "hysteresis" (dB),
+      // "maxPerMinute", "cfarMargin" (dB) and "cfarWindows". Others are
+      // ignored. Throws std::invalid_argument
+      // on bad JSON.
+      void set_json(const std::string& json);
+
+      // If the settings changed since seen, copy them out, update seen and
+      // return true. Returns false if they did not or a write is under way.
+      bool poll(trigger_settings& settings, uint32_t& seen) const;
+
+     private:
+      // Fixed point, so every field is a lock free atomic.
+      struct shared {
+        std::atomic<uint32_t> seq;
+        std::atomic<int32_t> level_mdb;
+        std::atomic<int32_t> holdoff_ms;
+        std::atomic<int32_t> hysteresis_mdb;
+        std::atomic<int32_t> max_per_minute;
+        std::atomic<int32_t> cfar_margin_mdb;
+        std::atomic<int32_t> cfar_windows;
+      };
+      shared* d_shared;
+
+      trigger_settings read() const;
+    };
+
+  } // namespace msod_sensor
+} // namespace gr
+
+#endif /* INCLUDED_MSOD_SENSOR_TRIGGER_POLICY_H */
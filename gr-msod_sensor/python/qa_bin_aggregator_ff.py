@@ -64,6 +64,22 @@ class qa_bin_aggregator_ff(gr_unittest.TestCase):
         result_data = dst.data()
         self.assertFloatTuplesAlmostEqual(expected_result, result_data, 6)
 
+    def test_003_t(self):
+        # several frames, and a channel split over runs that are not adjacent.
+        src_data = (1, 2, 3, 4, 5, 6, 7, 8,
+                    10, 20, 30, 40, 50, 60, 70, 80)
+        output_bin_index = (1, 1, 2, 2, 2, 1, 0, 9)
+        expected_result = (9, 12, 90, 120)
+        src = blocks.vector_source_f(src_data)
+        s2v = blocks.stream_to_vector(gr.sizeof_float, 8)
+        aggr = msod_sensor.bin_aggregator_ff(8, 2, (0,) * 8)
+        aggr.set_bin_index(output_bin_index)
+        dst = blocks.vector_sink_f(2)
+        self.tb.connect(src, s2v, aggr, dst)
+        self.tb.run()
+        result_data = dst.data()
+        self.assertFloatTuplesAlmostEqual(expected_result, result_data, 6)
+
 
 if __name__ == '__main__':
     gr_unittest.run(qa_bin_aggregator_ff, "qa_bin_aggregator_ff.xml")
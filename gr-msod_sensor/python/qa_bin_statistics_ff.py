@@ -72,6 +72,73 @@ class qa_bin_statistics_ff(gr_unittest.TestCase):
         result_data = dst.data()
         self.assertFloatTuplesAlmostEqual(expected_result, result_data, 6)
 
+    def test_003_t(self):
+        # a long interval of large vectors, held to a small input buffer:
+        # the statistic has to carry over between calls.
+        vlen = 1024
+        meas_interval = 64
+        src_data = []
+        for n in range(2 * meas_interval):
+            src_data.extend([float(n)] * vlen)
+        expected_result = [sum(range(meas_interval)) / float(meas_interval)] * vlen + \
+                          [sum(range(meas_interval, 2 * meas_interval)) / float(meas_interval)] * vlen
+        src = blocks.vector_source_f(src_data, False, vlen)
+        src.set_max_output_buffer(4)
+        stats = msod_sensor.bin_statistics_ff(vlen, meas_interval, 0)
+        dst = blocks.vector_sink_f(vlen)
+        self.tb.connect(src, stats, dst)
+        self.tb.run()
+        result_data = dst.data()
+        self.assertFloatTuplesAlmostEqual(expected_result, result_data, 4)
+
+    def test_004_t(self):
+        # several detectors in one pass, one per output.
+        src_data = (1, 4, 3, 2, 2, 6,
+                    0, 1, 5, 1, 1, 1)
+        expected = {
+            0: (2, 4, 2, 1),                                  # average
+            3: (1, 2, 0, 1),                                  # minimum
+            2: (1.8171206, 3.6342412, 1.7099759e-6, 1),       # log average (0 is clamped to 1e-18)
+            4: (2, 4, 1, 1),                                  # median
+            5: (2, 6, 2.5, 1),                                # max-hold, decay 0.5
+        }
+        more_dets = (3, 2, 4, 5)
+        src = blocks.vector_source_f(src_data)
+        s2v = blocks.stream_to_vector(gr.sizeof_float, 2)
+        stats = msod_sensor.bin_statistics_ff(2, 3, 0, more_dets, 0.5, 0.5)
+        self.tb.connect(src, s2v, stats)
+        sinks = []
+        for k, det in enumerate((0,) + more_dets):
+            dst = blocks.vector_sink_f(2)
+            self.tb.connect((stats, k), dst)
+            sinks.append((det, dst))
+        self.tb.run()
+        for det, dst in sinks:
+            self.assertFloatTuplesAlmostEqual(expected[det], dst.data(), 5)
+
+    def test_005_t(self):
+        # dBm straight out of the block, as float, int16 and int8.
+        src_data = (1e-3, 2e-6, 1e-3, 4e-6,
+                    3e-9, 1, 5e-9, 1e-12)
+        offset_db = 30.0
+        expected_db = (0, -25.22879, -53.97940, 26.98970)   # 10 log10(avg) + 30
+        src = blocks.vector_source_f(src_data)
+        s2v = blocks.stream_to_vector(gr.sizeof_float, 2)
+        self.tb.connect(src, s2v)
+        results = []
+        for output, sink in ((1, blocks.vector_sink_f(2)),
+                             (2, blocks.vector_sink_s(2)),
+                             (3, blocks.vector_sink_b(2))):
+            stats = msod_sensor.bin_statistics_ff(2, 2, 0, (), 0.9, 1.0,
+                                                  output, offset_db, 10.0 if output == 2 else 1.0)
+            self.tb.connect(s2v, stats, sink)
+            results.append(sink)
+        self.tb.run()
+        self.assertFloatTuplesAlmostEqual(expected_db, results[0].data(), 2)
+        self.assertEqual(tuple(results[1].data()), (0, -252, -540, 270))
+        self.assertEqual(tuple((b + 128) % 256 - 128 for b in results[2].data()),
+                         (0, -25, -54, 27))
+
 
 if __name__ == '__main__':
     gr_unittest.run(qa_bin_statistics_ff, "qa_bin_statistics_ff.xml")
@@ -22,10 +22,15 @@
 from gnuradio import gr, gr_unittest
 from gnuradio import blocks
 import msod_sensor_swig as capture
+import pmt
 import os
 import json
 import time
 import pymongo
+import numpy
+import threading
+import socket
+import BaseHTTPServer
 import os
 global mongoclient
 
@@ -40,6 +45,25 @@ class Struct(dict):
         self.__dict__ = self
 
 
+class EventHandler(BaseHTTPServer.BaseHTTPRequestHandler):
+    # Stand-in for the MSOD event endpoint. Fails the first
+    # server.failures requests (with server.failure_status, 503 unless
+    # set), then records the events it gets.
+    def do_POST(self):
+        length = int(self.headers.getheader("content-length"))
+        body = self.rfile.read(length)
+        if self.server.failures > 0:
+            self.server.failures -= 1
+            self.send_response(getattr(self.server, "failure_status", 503))
+        else:
+            self.server.events.append(json.loads(body))
+            self.send_response(200)
+        self.end_headers()
+
+    def log_message(self, *args):
+        pass
+
+
 def generate_data_message():
     f_start = 703990000
     f_stop = 714994000
@@ -141,6 +165,9 @@ class qa_capture_sink(gr_unittest.TestCase):
             {"SensorID": "TestSensor"})
         print "metadata count ", metadata.count()
         self.assertEquals(metadata.count(), count)
+        # the writer drains its queue when the flowgraph stops.
+        self.assertEquals(self.capture_sink.queue_depth(), 0)
+        self.assertEquals(self.capture_sink.dropped_captures(), 0)
 
     def test_002_t(self):
         self.capture_sink.stop_capture()
@@ -149,6 +176,373 @@ class qa_capture_sink(gr_unittest.TestCase):
             if file.startswith("capture"):
                 self.fail("File should not exist")
 
+    def test_003_t(self):
+        # pre-trigger history does not change the size of a capture.
+        tb = gr.top_block()
+        src = blocks.file_source(gr.sizeof_float, "/tmp/testdata.bin", False)
+        sink = capture.capture_sink(
+            itemsize=self.itemsize,
+            chunksize=self.chunksize,
+            samp_rate=10000000,
+            capture_dir="/tmp",
+            mongodb_port=MONGODB_PORT,
+            event_url="https://" + os.environ.get("MSOD_WEB_HOST") + ":" + str(443) + "/eventstream/postCaptureEvent",
+            time_offset=0,
+            pretrigger=100)
+        tb.connect(src, sink)
+        sink.set_event_message(generate_data_message())
+        sink.start_capture()
+        tb.run()
+        sizes = [os.stat("/tmp/" + f).st_size for f in os.listdir("/tmp")
+                 if f.startswith("capture")]
+        self.assertEquals(sizes, [self.chunksize * self.itemsize])
+
+    def test_004_t(self):
+        # captures mapped straight into a preallocated file.
+        self.capture_sink.set_event_message(generate_data_message())
+        self.capture_sink.set_file_mode(1)
+        self.capture_sink.start_capture()
+        self.tb.run()
+        files = [f for f in os.listdir("/tmp") if f.startswith("capture")]
+        self.assertEquals(len(files), 1)
+        with open("/tmp/" + files[0], "rb") as f:
+            captured = f.read()
+        with open("/tmp/testdata.bin", "rb") as f:
+            original = f.read(self.chunksize * self.itemsize)
+        self.assertEquals(captured, original)
+
+    def test_005_t(self):
+        # SigMF recording with its metadata sidecar.
+        self.capture_sink.set_event_message(generate_data_message())
+        self.capture_sink.set_sigmf_output(True)
+        self.capture_sink.set_center_freq(3.55e9)
+        self.capture_sink.start_capture()
+        self.tb.run()
+        files = sorted(f for f in os.listdir("/tmp") if f.startswith("capture"))
+        self.assertEquals(len(files), 2)
+        self.assertTrue(files[0].endswith(".sigmf-data"))
+        self.assertEquals(files[1], files[0][:-len("data")] + "meta")
+        self.assertEquals(os.stat("/tmp/" + files[0]).st_size,
+                          self.chunksize * self.itemsize)
+        with open("/tmp/" + files[1]) as f:
+            meta = json.load(f)
+        self.assertEquals(meta["global"]["core:datatype"], "rf32_le")
+        self.assertEquals(meta["global"]["core:sample_rate"], 10000000)
+        self.assertEquals(meta["captures"][0]["core:frequency"], 3.55e9)
+        self.assertEquals(meta["annotations"][0]["core:label"], "trigger")
+
+    def test_006_t(self):
+        # 16 bit integer storage halves the size of a float capture.
+        self.capture_sink.set_event_message(generate_data_message())
+        self.capture_sink.set_storage_format(1, 100.0)
+        self.capture_sink.start_capture()
+        self.tb.run()
+        files = [f for f in os.listdir("/tmp") if f.startswith("capture")]
+        self.assertEquals(len(files), 1)
+        captured = numpy.fromfile("/tmp/" + files[0], dtype=numpy.int16)
+        self.assertEquals(len(captured), self.chunksize)
+        original = numpy.fromfile("/tmp/testdata.bin", dtype=numpy.float32,
+                                  count=self.chunksize)
+        expected = numpy.clip(numpy.rint(original * 100.0), -32768, 32767)
+        self.assertTrue(numpy.all(numpy.abs(captured - expected) <= 1))
+
+    def test_007_t(self):
+        # streamed capture written in segments much smaller than the capture.
+        self.capture_sink.set_event_message(generate_data_message())
+        self.capture_sink.set_file_mode(2)
+        self.capture_sink.set_segment_size(64)
+        self.capture_sink.set_writer_policy(4, 0)
+        self.capture_sink.start_capture()
+        self.tb.run()
+        files = [f for f in os.listdir("/tmp") if f.startswith("capture")]
+        self.assertEquals(len(files), 1)
+        with open("/tmp/" + files[0], "rb") as f:
+            captured = f.read()
+        with open("/tmp/testdata.bin", "rb") as f:
+            original = f.read(self.chunksize * self.itemsize)
+        self.assertEquals(captured, original)
+        metadata = mongoclient.iqcapture.dataMessages.find(
+            {"SensorID": "TestSensor"})
+        self.assertEquals(metadata.count(), 1)
+        self.assertEquals(metadata[0]["SampleCount"], self.chunksize)
+        # only segments were ever buffered, never the whole capture.
+        self.assertLessEqual(self.capture_sink.peak_buffer_bytes(),
+                             4 * 64 * self.itemsize)
+
+    def test_008_t(self):
+        # events survive a server that fails at first, via the outbox.
+        server = BaseHTTPServer.HTTPServer(("127.0.0.1", 0), EventHandler)
+        server.failures = 2
+        server.events = []
+        thread = threading.Thread(target=server.serve_forever)
+        thread.daemon = True
+        thread.start()
+        outbox = "/tmp/qa_capture_sink_outbox.log"
+        if os.path.exists(outbox):
+            os.remove(outbox)
+        tb = gr.top_block()
+        src = blocks.file_source(gr.sizeof_float, "/tmp/testdata.bin", False)
+        sink = capture.capture_sink(
+            itemsize=self.itemsize,
+            chunksize=self.chunksize,
+            samp_rate=10000000,
+            capture_dir="/tmp",
+            mongodb_port=MONGODB_PORT,
+            event_url="http://127.0.0.1:%d/eventstream/postCaptureEvent" %
+            server.server_port,
+            time_offset=0)
+        tb.connect(src, sink)
+        sink.set_event_outbox(outbox, 0.1, 0.5)
+        sink.set_event_message(generate_data_message())
+        sink.start_capture()
+        tb.run()
+        deadline = time.time() + 10
+        while sink.pending_events() > 0 and time.time() < deadline:
+            time.sleep(0.1)
+        server.shutdown()
+        self.assertEquals(sink.pending_events(), 0)
+        self.assertEquals(len(server.events), 1)
+        self.assertEquals(server.events[0]["SampleCount"], self.chunksize)
+        # delivered: only the header (the head offset) is left.
+        self.assertEquals(os.stat(outbox).st_size, 8)
+        os.remove(outbox)
+
+    def test_009_t(self):
+        # no database: the capture records go to a local JSON lines file.
+        records = "/tmp/qa_capture_records.jsonl"
+        if os.path.exists(records):
+            os.remove(records)
+        tb = gr.top_block()
+        src = blocks.file_source(gr.sizeof_float, "/tmp/testdata.bin", False)
+        sink = capture.capture_sink(
+            itemsize=self.itemsize,
+            chunksize=self.chunksize,
+            samp_rate=10000000,
+            capture_dir="/tmp",
+            mongodb_port=0,
+            event_url="https://" + os.environ.get("MSOD_WEB_HOST") + ":" + str(443) + "/eventstream/postCaptureEvent",
+            time_offset=0)
+        sink.set_metadata_backend(1, records)
+        tb.connect(src, sink)
+        sink.set_event_message(generate_data_message())
+        sink.start_capture()
+        tb.run()
+        lines = open(records).read().splitlines()
+        self.assertEquals(len(lines), 1)
+        record = json.loads(lines[0])
+        self.assertEquals(record["_ns"], "iqcapture.dataMessages")
+        self.assertEquals(record["SensorID"], "TestSensor")
+        self.assertTrue(os.path.exists(record["_capture_file"]))
+        os.remove(records)
+
+    def test_010_t(self):
+        # an event the server rejects goes to the dead letter file and
+        # does not hold up the next one.
+        server = BaseHTTPServer.HTTPServer(("127.0.0.1", 0), EventHandler)
+        server.failures = 1
+        server.failure_status = 400
+        server.events = []
+        thread = threading.Thread(target=server.serve_forever)
+        thread.daemon = True
+        thread.start()
+        outbox = "/tmp/qa_capture_sink_outbox.log"
+        for f in (outbox, outbox + ".rejected"):
+            if os.path.exists(f):
+                os.remove(f)
+        tb = gr.top_block()
+        src = blocks.vector_source_f([0.0] * 1000, True)
+        throttle = blocks.throttle(gr.sizeof_float, 100000)
+        sink = capture.capture_sink(
+            itemsize=self.itemsize,
+            chunksize=self.chunksize,
+            samp_rate=10000000,
+            capture_dir="/tmp",
+            mongodb_port=MONGODB_PORT,
+            event_url="http://127.0.0.1:%d/eventstream/postCaptureEvent" %
+            server.server_port,
+            time_offset=0)
+        tb.connect(src, throttle, sink)
+        sink.set_event_outbox(outbox, 0.1, 0.5)
+        sink.set_event_message(generate_data_message())
+        tb.start()
+        for n in range(2):
+            sink.start_capture()
+            deadline = time.time() + 10
+            while (server.failures > 0 or len(server.events) < n) and \
+                    time.time() < deadline:
+                time.sleep(0.1)
+            while sink.pending_events() > 0 and time.time() < deadline:
+                time.sleep(0.1)
+        tb.stop()
+        tb.wait()
+        server.shutdown()
+        self.assertEquals(sink.pending_events(), 0)
+        self.assertEquals(len(server.events), 1)
+        rejected = open(outbox + ".rejected").read().splitlines()
+        self.assertEquals(len(rejected), 1)
+        self.assertEquals(json.loads(rejected[0])["SampleCount"], self.chunksize)
+        os.remove(outbox)
+        os.remove(outbox + ".rejected")
+
+    def test_011_t(self):
+        # no pre-trigger samples, and a trigger from a branch that is
+        # behind the sink: the capture still starts at the trigger offset.
+        ramp = [float(n) for n in range(100000)]
+        tb = gr.top_block()
+        src = blocks.vector_source_f(ramp, True)
+        throttle = blocks.throttle(gr.sizeof_float, 20000)
+        sink = capture.capture_sink(
+            itemsize=self.itemsize,
+            chunksize=self.chunksize,
+            samp_rate=10000000,
+            capture_dir="/tmp",
+            mongodb_port=MONGODB_PORT,
+            event_url="https://" + os.environ.get("MSOD_WEB_HOST") + ":" + str(443) + "/eventstream/postCaptureEvent",
+            time_offset=0,
+            pretrigger=0)
+        tb.connect(src, throttle, sink)
+        sink.set_event_message(generate_data_message())
+        tb.start()
+        time.sleep(0.5)
+        offset = sink.nitems_read(0) - 2000
+        msg = pmt.make_dict()
+        msg = pmt.dict_add(msg, pmt.intern("trigger"), pmt.intern("start"))
+        msg = pmt.dict_add(msg, pmt.intern("offset"), pmt.from_uint64(offset))
+        sink.to_basic_block()._post(pmt.intern("capture"), msg)
+        deadline = time.time() + 10
+        while time.time() < deadline and \
+                not [f for f in os.listdir("/tmp") if f.startswith("capture")]:
+            time.sleep(0.1)
+        tb.stop()
+        tb.wait()
+        files = [f for f in os.listdir("/tmp") if f.startswith("capture")]
+        self.assertEquals(len(files), 1)
+        captured = numpy.fromfile("/tmp/" + files[0], dtype=numpy.float32)
+        expected = [float((offset + n) % len(ramp)) for n in range(self.chunksize)]
+        self.assertEquals(list(captured), expected)
+
+    def test_012_t(self):
+        # unacknowledged metadata inserts still reach mongod.
+        self.capture_sink.set_metadata_acknowledged(False)
+        self.capture_sink.set_event_message(generate_data_message())
+        self.capture_sink.start_capture()
+        self.tb.run()
+        # the writer is shared by every sink on this port.
+        self.capture_sink.set_metadata_acknowledged(True)
+        files = [f for f in os.listdir("/tmp") if f.startswith("capture")]
+        self.assertEquals(len(files), 1)
+        deadline = time.time() + 5
+        while time.time() < deadline and \
+                mongoclient.iqcapture.dataMessages.find(
+                    {"SensorID": "TestSensor"}).count() < 1:
+            time.sleep(0.1)
+        metadata = mongoclient.iqcapture.dataMessages.find(
+            {"SensorID": "TestSensor"})
+        self.assertEquals(metadata.count(), 1)
+        self.assertEquals(metadata[0]["SampleCount"], self.chunksize)
+
+    def test_013_t(self):
+        # mongod unreachable: a stream of captures does not turn the
+        # reconnect backoff into a reconnect per record, and stopping
+        # does not wait for records that cannot be written.
+        listener = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        listener.bind(("127.0.0.1", 0))
+        listener.listen(16)
+        attempts = [0]
+
+        def refuse():
+            while True:
+                try:
+                    conn, _ = listener.accept()
+                except socket.error:
+                    return
+                attempts[0] += 1
+                conn.close()
+        thread = threading.Thread(target=refuse)
+        thread.daemon = True
+        thread.start()
+        server = BaseHTTPServer.HTTPServer(("127.0.0.1", 0), EventHandler)
+        server.failures = 0
+        server.events = []
+        server_thread = threading.Thread(target=server.serve_forever)
+        server_thread.daemon = True
+        server_thread.start()
+        tb = gr.top_block()
+        src = blocks.vector_source_f([float(n) for n in range(10000)], True)
+        throttle = blocks.throttle(gr.sizeof_float, 20000)
+        sink = capture.capture_sink(
+            itemsize=self.itemsize,
+            chunksize=self.chunksize,
+            samp_rate=10000000,
+            capture_dir="/tmp",
+            mongodb_port=listener.getsockname()[1],
+            event_url="http://127.0.0.1:%d/eventstream/postCaptureEvent" %
+            server.server_port,
+            time_offset=0)
+        tb.connect(src, throttle, sink)
+        sink.set_event_message(generate_data_message())
+        tb.start()
+        for i in range(30):
+            sink.start_capture()
+            time.sleep(0.1)
+        started = time.time()
+        tb.stop()
+        tb.wait()
+        stopping = time.time() - started
+        listener.close()
+        server.shutdown()
+        self.assertGreaterEqual(len(server.events), 10)
+        # connects at 0, 0.5, 1.5 and 3.5 s at most, not one per record.
+        self.assertGreaterEqual(attempts[0], 1)
+        self.assertLessEqual(attempts[0], 5)
+        self.assertLess(stopping, 2)
+
+    def test_014_t(self):
+        # a trigger that comes in during a capture starts the next one, at
+        # its own offset, once the first is complete.
+        ramp = [float(n) for n in range(100000)]
+        tb = gr.top_block()
+        src = blocks.vector_source_f(ramp, True)
+        throttle = blocks.throttle(gr.sizeof_float, 2000)
+        sink = capture.capture_sink(
+            itemsize=self.itemsize,
+            chunksize=self.chunksize,
+            samp_rate=10000000,
+            capture_dir="/tmp",
+            mongodb_port=MONGODB_PORT,
+            event_url="https://" + os.environ.get("MSOD_WEB_HOST") + ":" + str(443) + "/eventstream/postCaptureEvent",
+            time_offset=0,
+            pretrigger=0)
+        tb.connect(src, throttle, sink)
+        sink.set_event_message(generate_data_message())
+
+        def trigger(offset):
+            msg = pmt.make_dict()
+            msg = pmt.dict_add(msg, pmt.intern("trigger"), pmt.intern("start"))
+            msg = pmt.dict_add(msg, pmt.intern("offset"), pmt.from_uint64(offset))
+            sink.to_basic_block()._post(pmt.intern("capture"), msg)
+
+        # small calls to work(), so the first capture spans several.
+        tb.start(100)
+        time.sleep(0.2)
+        first = sink.nitems_read(0) + 400
+        trigger(first)
+        deadline = time.time() + 10
+        while time.time() < deadline and sink.nitems_read(0) < first + 100:
+            time.sleep(0.01)
+        trigger(first + 250)
+        while time.time() < deadline and \
+                len([f for f in os.listdir("/tmp") if f.startswith("capture")]) < 2:
+            time.sleep(0.1)
+        tb.stop()
+        tb.wait()
+        files = [f for f in os.listdir("/tmp") if f.startswith("capture")]
+        self.assertEquals(len(files), 2)
+        captures = sorted([list(numpy.fromfile("/tmp/" + f, dtype=numpy.float32))
+                           for f in files])
+        for start, captured in zip((first, first + 250), captures):
+            expected = [float((start + n) % len(ramp)) for n in range(self.chunksize)]
+            self.assertEquals(captured, expected)
 
 if __name__ == '__main__':
     global mongoclient
@@ -0,0 +1,88 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+# 
+# Copyright 2014 <+YOU OR YOUR COMPANY+>.
+# 
+# This is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 3, or (at your option)
+# any later version.
+# 
+# This software is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# 
+# You should have received a copy of the GNU General Public License
+# along with this software; see the file COPYING.  If not, write to
+# the Free Software Foundation, Inc., 51 Franklin Street,
+# Boston, MA 02110-1301, USA.
+#
+
+from gnuradio import gr, gr_unittest
+from gnuradio import blocks, fft, filter
+import random
+import msod_sensor_swig as msod_sensor
+
+
+class qa_channel_power_cb(gr_unittest.TestCase):
+    def setUp(self):
+        self.tb = gr.top_block()
+        random.seed(1)
+
+    def tearDown(self):
+        self.tb = None
+
+    def reference(self, src_data, fft_size, window, num_ch, bin_index,
+                  meas_interval, det, offset_db):
+        # The chain of stock blocks the fused block replaces.
+        tb = gr.top_block()
+        src = blocks.vector_source_c(src_data)
+        s2v = blocks.stream_to_vector(gr.sizeof_gr_complex, fft_size)
+        ffter = fft.fft_vcc(fft_size, True, window, True)
+        c2mag = blocks.complex_to_mag_squared(fft_size)
+        aggr = msod_sensor.bin_aggregator_ff(fft_size, num_ch, bin_index)
+        stats = msod_sensor.bin_statistics_ff(num_ch, meas_interval, det)
+        w2dbm = blocks.nlog10_ff(10, num_ch, offset_db)
+        f2c = blocks.float_to_char(num_ch, 1.0)
+        dst = blocks.vector_sink_b(num_ch)
+        tb.connect(src, s2v, ffter, c2mag, aggr, stats, w2dbm, f2c, dst)
+        tb.run()
+        return dst.data()
+
+    def check(self, fft_size, num_ch, meas_interval, det):
+        src_data = [complex(random.gauss(0, 1), random.gauss(0, 1))
+                    for i in range(fft_size * meas_interval * 5 + 7)]
+        window = filter.window.blackmanharris(fft_size)
+        # channels over the middle of the band, DC bin left out.
+        bin_index = [0] * fft_size
+        per_ch = (fft_size / 2) / num_ch
+        for j in range(fft_size / 4, fft_size / 4 + per_ch * num_ch):
+            bin_index[j] = (j - fft_size / 4) / per_ch + 1
+        bin_index[(fft_size + 1) / 2] = 0
+        offset_db = 20.0
+        power = msod_sensor.channel_power_cb(fft_size, window, num_ch,
+                                             bin_index, meas_interval, det,
+                                             offset_db)
+        src = blocks.vector_source_c(src_data)
+        dst = blocks.vector_sink_b(num_ch)
+        self.tb.connect(src, power, dst)
+        self.tb.run()
+        result = dst.data()
+        expected = self.reference(src_data, fft_size, window, num_ch,
+                                  bin_index, meas_interval, det, offset_db)
+        self.assertEqual(len(result), 5 * num_ch)
+        self.assertEqual(len(result), len(expected))
+        # Rounding to whole dB may come out differently at the .5 edge.
+        for r, e in zip(result, expected):
+            self.assertTrue(abs(((r + 128) % 256) - ((e + 128) % 256)) <= 1)
+
+    def test_001_t(self):
+        self.check(256, 8, 4, 0)
+
+    def test_002_t(self):
+        self.check(255, 5, 3, 1)
+
+
+if __name__ == '__main__':
+    gr_unittest.run(qa_channel_power_cb, "qa_channel_power_cb.xml")
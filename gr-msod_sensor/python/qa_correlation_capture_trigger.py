@@ -0,0 +1,81 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+#
+# Copyright 2016 <+YOU OR YOUR COMPANY+>.
+#
+# This is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 3, or (at your option)
+# any later version.
+#
+# This software is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this software; see the file COPYING.  If not, write to
+# the Free Software Foundation, Inc., 51 Franklin Street,
+# Boston, MA 02110-1301, USA.
+#
+
+from gnuradio import gr, gr_unittest
+from gnuradio import blocks
+import pmt
+import random
+import msod_sensor_swig as msod_sensor
+
+
+class qa_correlation_capture_trigger(gr_unittest.TestCase):
+    def setUp(self):
+        self.tb = gr.top_block()
+        random.seed(1)
+        qpsk = (1 + 0j, 1j, -1 + 0j, -1j)
+        self.references = ([random.choice(qpsk) for i in range(64)],
+                           [random.choice(qpsk) for i in range(40)])
+
+    def tearDown(self):
+        self.tb = None
+
+    def noise(self, n):
+        return [complex(random.gauss(0, 0.01), random.gauss(0, 0.01))
+                for i in range(n)]
+
+    def run_trigger(self, trigger, src_data):
+        src = blocks.vector_source_c(src_data)
+        dbg = blocks.message_debug()
+        trigger.arm()
+        self.tb.connect(src, trigger)
+        self.tb.msg_connect(trigger, "trigger", dbg, "store")
+        self.tb.run()
+        return dbg
+
+    def field(self, msg, key):
+        return pmt.dict_ref(msg, pmt.intern(key), pmt.PMT_NIL)
+
+    def test_001_t(self):
+        # the second reference, at 1/10 of full scale, and spanning two FFTs.
+        src_data = self.noise(3000)
+        for k, x in enumerate(self.references[1]):
+            src_data[1234 + k] += 0.1 * x
+        trigger = msod_sensor.correlation_capture_trigger(self.references, 0.8, 256)
+        dbg = self.run_trigger(trigger, src_data)
+        self.assertEqual(dbg.num_messages(), 1)
+        msg = dbg.get_message(0)
+        self.assertEqual(pmt.to_long(self.field(msg, "reference")), 1)
+        self.assertEqual(pmt.to_uint64(self.field(msg, "offset")), 1234)
+        self.assertEqual(pmt.to_long(self.field(msg, "window")), 40)
+        self.assertGreater(pmt.to_double(self.field(msg, "correlation")), 0.8)
+        self.assertFalse(trigger.is_armed())
+
+    def test_002_t(self):
+        # noise alone, however strong, does not correlate.
+        src_data = [100 * x for x in self.noise(3000)]
+        trigger = msod_sensor.correlation_capture_trigger(self.references, 0.8)
+        dbg = self.run_trigger(trigger, src_data)
+        self.assertEqual(dbg.num_messages(), 0)
+        self.assertTrue(trigger.is_armed())
+
+
+if __name__ == '__main__':
+    gr_unittest.run(qa_correlation_capture_trigger, "qa_correlation_capture_trigger.xml")
@@ -22,6 +22,7 @@
 from gnuradio import gr, gr_unittest
 from gnuradio import blocks
 import os
+import pmt
 import msod_sensor_swig as capture
 
 MONGODB_PORT = 33000
@@ -58,6 +59,27 @@ class qa_dummy_capture_trigger(gr_unittest.TestCase):
     def tearDown(self):
         self.tb = None
 
+    def test_002_t(self):
+        # trigger as a pure sink in parallel with the capture sink.
+        tb = gr.top_block()
+        src = blocks.file_source(gr.sizeof_float, "/tmp/testdata.bin", False)
+        sink = capture.iqcapture_sink(itemsize=gr.sizeof_float,
+                                      chunksize=500,
+                                      capture_dir="/tmp",
+                                      mongodb_port=MONGODB_PORT)
+        trigger = capture.dummy_capture_trigger(itemsize=gr.sizeof_float)
+        dbg = blocks.message_debug()
+        trigger.arm()
+        tb.connect(src, trigger)
+        tb.connect(src, sink)
+        tb.msg_connect(trigger, "trigger", sink, "capture")
+        tb.msg_connect(trigger, "trigger", dbg, "store")
+        tb.run()
+        self.assertEqual(dbg.num_messages(), 1)
+        offset = pmt.dict_ref(dbg.get_message(0), pmt.intern("offset"),
+                              pmt.PMT_NIL)
+        self.assertEqual(pmt.to_uint64(offset), 0)
+
     def test_001_t(self):
         # set up fg
         self.tb.run()
@@ -25,6 +25,8 @@ import os
 import json
 import time
 import pymongo
+import numpy
+import pmt
 global mongoclient
 import msod_sensor_swig as capture
 
@@ -84,6 +86,54 @@ class qa_iqcapture_sink(gr_unittest.TestCase):
         self.tb.run()
         # check data
 
+    def capture_ramp(self, double_mapped):
+        # run a ramp through the sink well past the size of its ring, then
+        # trigger a capture.
+        chunksize = 512
+        tb = gr.top_block()
+        src = blocks.vector_source_f([float(n) for n in range(1000000)], True)
+        throttle = blocks.throttle(gr.sizeof_float, 20000)
+        sink = capture.iqcapture_sink(itemsize=gr.sizeof_float,
+                                      chunksize=chunksize,
+                                      capture_dir="/tmp",
+                                      mongodb_port=33000,
+                                      double_mapped=double_mapped)
+        tb.connect(src, throttle, sink)
+        tb.start()
+        time.sleep(0.5)
+        sink.to_basic_block()._post(pmt.intern("capture"), pmt.PMT_T)
+        deadline = time.time() + 10
+        files = []
+        while time.time() < deadline:
+            files = [f for f in os.listdir("/tmp") if f.startswith("iqcapture")]
+            if files and os.stat("/tmp/" + files[0]).st_size == chunksize * 4:
+                break
+            time.sleep(0.1)
+        tb.stop()
+        tb.wait()
+        self.assertEquals(len(files), 1)
+        captured = numpy.fromfile("/tmp/" + files[0], dtype=numpy.float32)
+        os.remove("/tmp/" + files[0])
+        return captured, chunksize
+
+    def check_last_items(self, captured, chunksize):
+        # the last chunksize items, oldest first, from after the ring
+        # wrapped around at least once.
+        self.assertEquals(len(captured), chunksize)
+        first = int(captured[0])
+        self.assertTrue(first >= chunksize)
+        self.assertEquals(list(captured), [float(first + n) for n in range(chunksize)])
+
+    def test_002_t(self):
+        # the ring is exactly chunksize items, so the capture is cut at the
+        # wrap point and written from two pieces.
+        captured, chunksize = self.capture_ramp(False)
+        self.check_last_items(captured, chunksize)
+
+    def test_003_t(self):
+        # same with the history ring mapped twice in memory.
+        captured, chunksize = self.capture_ramp(True)
+        self.check_last_items(captured, chunksize)
 
 if __name__ == '__main__':
     gr_unittest.run(qa_iqcapture_sink, "qa_iqcapture_sink.xml")
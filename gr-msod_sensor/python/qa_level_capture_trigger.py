@@ -21,6 +21,10 @@
 
 from gnuradio import gr, gr_unittest
 from gnuradio import blocks
+import pmt
+import math
+import json
+from multiprocessing import Process
 import msod_sensor_swig as msod_sensor
 
 
@@ -31,10 +35,114 @@ class qa_level_capture_trigger(gr_unittest.TestCase):
     def tearDown(self):
         self.tb = None
 
+    def run_trigger(self, trigger, src_data):
+        src = blocks.vector_source_c(src_data)
+        dst = blocks.null_sink(gr.sizeof_gr_complex)
+        dbg = blocks.message_debug()
+        trigger.arm()
+        self.tb.connect(src, trigger, dst)
+        self.tb.msg_connect(trigger, "trigger", dbg, "store")
+        self.tb.run()
+        return dbg
+
+    def straddling_burst(self):
+        # -40 dBm is 1e-4. The burst has 1.5e-4 for 100 samples, placed so
+        # that disjoint windows of 100 see only half of it.
+        amplitude = math.sqrt(1.5e-4)
+        return [0j] * 50 + [amplitude + 0j] * 100 + [0j] * 250
+
     def test_001_t(self):
-        # set up fg
+        trigger = msod_sensor.level_capture_trigger(gr.sizeof_gr_complex, -40, 100)
+        dbg = self.run_trigger(trigger, self.straddling_burst())
+        self.assertEqual(dbg.num_messages(), 0)
+
+    def test_002_t(self):
+        # the sliding window sees the whole burst.
+        trigger = msod_sensor.level_capture_trigger(gr.sizeof_gr_complex, -40, 100, 1)
+        dbg = self.run_trigger(trigger, self.straddling_burst())
+        self.assertEqual(dbg.num_messages(), 1)
+        msg = dbg.get_message(0)
+        window = pmt.dict_ref(msg, pmt.intern("window"), pmt.PMT_NIL)
+        self.assertEqual(pmt.to_long(window), 100)
+
+    def test_003_t(self):
+        # a short window fires on the burst, the long one would not.
+        trigger = msod_sensor.level_capture_trigger(gr.sizeof_gr_complex, -40, 400, 1, (50,))
+        dbg = self.run_trigger(trigger, self.straddling_burst())
+        self.assertEqual(dbg.num_messages(), 1)
+        msg = dbg.get_message(0)
+        window = pmt.dict_ref(msg, pmt.intern("window"), pmt.PMT_NIL)
+        self.assertEqual(pmt.to_long(window), 50)
+
+    def test_004_t(self):
+        # armed from a forked process, as the sslsocket_sink command
+        # handler does; one shot, so the second burst is ignored.
+        trigger = msod_sensor.level_capture_trigger(gr.sizeof_gr_complex, -40, 100, 1)
+        armer = Process(target=trigger.arm)
+        armer.start()
+        armer.join()
+        self.assertTrue(trigger.is_armed())
+        src = blocks.vector_source_c(self.straddling_burst() * 2)
+        dbg = blocks.message_debug()
+        self.tb.connect(src, trigger)
+        self.tb.msg_connect(trigger, "trigger", dbg, "store")
         self.tb.run()
-        # check data
+        self.assertEqual(dbg.num_messages(), 1)
+        self.assertFalse(trigger.is_armed())
+
+    def run_bursts(self, params):
+        # two bursts far enough apart to be seen in different calls.
+        trigger = msod_sensor.level_capture_trigger(gr.sizeof_gr_complex, -40, 100, 1)
+        trigger.set_trigger_params(json.dumps(params))
+        burst = self.straddling_burst() + [0j] * 20000
+        src = blocks.vector_source_c(burst * 2)
+        src.set_max_output_buffer(4096)
+        dbg = blocks.message_debug()
+        trigger.arm()
+        self.tb.connect(src, trigger)
+        self.tb.msg_connect(trigger, "trigger", dbg, "store")
+        self.tb.run()
+        return trigger, dbg
+
+    def test_005_t(self):
+        # re-armed right away: both bursts fire and it stays armed.
+        trigger, dbg = self.run_bursts({"holdoff": 0})
+        self.assertEqual(dbg.num_messages(), 2)
+        self.assertTrue(trigger.is_armed())
+
+    def test_006_t(self):
+        # re-armed, but limited to one trigger a minute.
+        trigger, dbg = self.run_bursts({"holdoff": 0, "maxPerMinute": 1})
+        self.assertEqual(dbg.num_messages(), 1)
+
+    def test_007_t(self):
+        # the level can be moved over the bursts.
+        trigger, dbg = self.run_bursts({"holdoff": 0, "level": -30})
+        self.assertEqual(dbg.num_messages(), 0)
+
+    def test_008_t(self):
+        # CFAR: a burst 10 dB over a -60 dBm floor fires, though it is
+        # well under the -40 dBm level.
+        noise = [1e-3 + 0j] * 2000
+        burst = [math.sqrt(1e-5) + 0j] * 200
+        trigger = msod_sensor.level_capture_trigger(gr.sizeof_gr_complex, -40, 100)
+        trigger.set_trigger_params(json.dumps({"cfarMargin": 6, "cfarWindows": 8}))
+        dbg = self.run_trigger(trigger, noise + burst + noise)
+        self.assertEqual(dbg.num_messages(), 1)
+        offset = pmt.dict_ref(dbg.get_message(0), pmt.intern("offset"), pmt.PMT_NIL)
+        self.assertEqual(pmt.to_uint64(offset), 2000)
+
+    def test_009_t(self):
+        # CFAR: a floor that steps up 15 dB fires once, then the floor
+        # follows it and the trigger stays quiet.
+        params = {"cfarMargin": 6, "cfarWindows": 8, "holdoff": 0, "hysteresis": 3}
+        trigger = msod_sensor.level_capture_trigger(gr.sizeof_gr_complex, -40, 100)
+        trigger.set_trigger_params(json.dumps(params))
+        low = [1e-3 + 0j] * 1000
+        high = [math.sqrt(10 ** -4.5) + 0j] * 3000
+        dbg = self.run_trigger(trigger, low + high)
+        self.assertEqual(dbg.num_messages(), 1)
+        self.assertTrue(trigger.is_armed())
 
 
 if __name__ == '__main__':
@@ -0,0 +1,118 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+#
+# Copyright 2016 <+YOU OR YOUR COMPANY+>.
+#
+# This is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 3, or (at your option)
+# any later version.
+#
+# This software is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this software; see the file COPYING.  If not, write to
+# the Free Software Foundation, Inc., 51 Franklin Street,
+# Boston, MA 02110-1301, USA.
+#
+
+from gnuradio import gr, gr_unittest
+from gnuradio import blocks
+import pmt
+import msod_sensor_swig as msod_sensor
+
+
+class qa_subband_capture_trigger(gr_unittest.TestCase):
+    def setUp(self):
+        self.tb = gr.top_block()
+
+    def tearDown(self):
+        self.tb = None
+
+    def spectrum(self):
+        # a flat floor of 1, a strong signal in channel 0, which is not
+        # watched, then a 13 dB one in channel 2.
+        vectors = [(1, 1, 1, 1)] * 20
+        vectors += [(1000, 1, 1, 1), (1, 1, 20, 1)]
+        vectors += [(1, 1, 1, 1)] * 5
+        return [x for v in vectors for x in v]
+
+    def run_trigger(self, trigger, arm):
+        src = blocks.vector_source_f(self.spectrum(), False, 4)
+        dbg = blocks.message_debug()
+        if arm:
+            trigger.arm()
+        self.tb.connect(src, trigger)
+        self.tb.msg_connect(trigger, "trigger", dbg, "store")
+        self.tb.run()
+        return dbg
+
+    def test_001_t(self):
+        trigger = msod_sensor.subband_capture_trigger(4, (1, 2), (10,), 64)
+        dbg = self.run_trigger(trigger, True)
+        self.assertEqual(dbg.num_messages(), 1)
+        msg = dbg.get_message(0)
+        self.assertEqual(pmt.to_long(pmt.dict_ref(msg, pmt.intern("channel"), pmt.PMT_NIL)), 2)
+        self.assertEqual(pmt.to_uint64(pmt.dict_ref(msg, pmt.intern("offset"), pmt.PMT_NIL)), 21 * 64)
+        self.assertFalse(trigger.is_armed())
+        # the burst is far shorter than the floor window.
+        self.assertFloatTuplesAlmostEqual(trigger.noise_floor(), (0, 0), 4)
+
+    def test_002_t(self):
+        # over the floor, but not by the per channel threshold.
+        trigger = msod_sensor.subband_capture_trigger(4, (1, 2), (10, 15), 64)
+        dbg = self.run_trigger(trigger, True)
+        self.assertEqual(dbg.num_messages(), 0)
+        self.assertTrue(trigger.is_armed())
+
+    def test_003_t(self):
+        # not armed.
+        trigger = msod_sensor.subband_capture_trigger(4, (1, 2), (10,), 64)
+        dbg = self.run_trigger(trigger, False)
+        self.assertEqual(dbg.num_messages(), 0)
+
+    def test_004_t(self):
+        # a 13 dB tone in channel 2 that stays on for most of the floor
+        # window: the floor does not move, so the tone would still
+        # trigger a capture when armed again.
+        vectors = [(1, 1, 1, 1)] * 20 + [(1, 1, 20, 1)] * 900
+        src = blocks.vector_source_f([x for v in vectors for x in v], False, 4)
+        dbg = blocks.message_debug()
+        trigger = msod_sensor.subband_capture_trigger(4, (1, 2), (10,), 64)
+        trigger.arm()
+        self.tb.connect(src, trigger)
+        self.tb.msg_connect(trigger, "trigger", dbg, "store")
+        self.tb.run()
+        self.assertEqual(dbg.num_messages(), 1)
+        self.assertFloatTuplesAlmostEqual(trigger.noise_floor(), (0, 0), 4)
+
+    def test_005_t(self):
+        # the floor of channel 2 steps up by 10 dB for good. Armed again
+        # every 100 vectors, the trigger fires on the step, then stops
+        # once the new floor fills the 500 vector window.
+        trigger = msod_sensor.subband_capture_trigger(4, (1, 2), (6,), 64, 0.01, 16, 500)
+        src = blocks.vector_source_f([1] * 4 * 20, False, 4)
+        dbg = blocks.message_debug()
+        self.tb.connect(src, trigger)
+        self.tb.msg_connect(trigger, "trigger", dbg, "store")
+        self.tb.run()
+        fired = []
+        for segment in range(20):
+            src.set_data([1, 1, 10, 1] * 100)
+            trigger.arm()
+            self.tb.run()
+            fired.append(dbg.num_messages())
+        self.assertEqual(fired[0], 1)
+        # no triggers from 700 vectors after the step on.
+        self.assertEqual(fired[-1], fired[6])
+        self.assertTrue(trigger.is_armed())
+        floor = trigger.noise_floor()
+        self.assertAlmostEqual(floor[0], 0, 4)
+        self.assertAlmostEqual(floor[1], 10, 1)
+
+
+if __name__ == '__main__':
+    gr_unittest.run(qa_subband_capture_trigger, "qa_subband_capture_trigger.xml")
@@ -44,10 +44,12 @@ def command_handler(trigger, sock, top_block, pid, host, sensorId):
                                                                indent=4)
             if commandJson["command"] == "arm":
                 print "Arming trigger"
-                trigger.arm()
-                if "triggerParams" in commandJson:
+                # Settings first, so the trigger arms with them.
+                if "triggerParams" in commandJson and \
+                        hasattr(trigger, "set_trigger_params"):
                     triggerParams = commandJson["triggerParams"]
-                    trigger.setTriggerParams(json.dumps(triggerParams))
+                    trigger.set_trigger_params(json.dumps(triggerParams))
+                trigger.arm()
             elif commandJson["command"] == "disarm":
                 trigger.disarm()
             elif commandJson["command"] == "garbage_collect":
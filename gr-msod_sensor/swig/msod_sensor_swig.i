@@ -10,6 +10,7 @@
 %{
 #include "msod_sensor/bin_aggregator_ff.h"
 #include "msod_sensor/bin_statistics_ff.h"
+#include "msod_sensor/channel_power_cb.h"
 #include "msod_sensor/file_descriptor_sink.h"
 #include "msod_sensor/file_descriptor_source.h"
 #include "msod_sensor/threshold_timestamp.h"
@@ -17,6 +18,8 @@
 #include "msod_sensor/iqcapture_sink.h"
 #include "msod_sensor/dummy_capture_trigger.h"
 #include "msod_sensor/level_capture_trigger.h"
+#include "msod_sensor/subband_capture_trigger.h"
+#include "msod_sensor/correlation_capture_trigger.h"
 %}
 
 %include "msod_sensor/bin_aggregator_ff.h"
@@ -24,6 +27,8 @@ GR_SWIG_BLOCK_MAGIC2(msod_sensor, bin_aggregator_ff);
 
 %include "msod_sensor/bin_statistics_ff.h"
 GR_SWIG_BLOCK_MAGIC2(msod_sensor, bin_statistics_ff);
+%include "msod_sensor/channel_power_cb.h"
+GR_SWIG_BLOCK_MAGIC2(msod_sensor, channel_power_cb);
 %include "msod_sensor/file_descriptor_sink.h"
 GR_SWIG_BLOCK_MAGIC2(msod_sensor, file_descriptor_sink);
 %include "msod_sensor/file_descriptor_source.h"
@@ -41,3 +46,7 @@ GR_SWIG_BLOCK_MAGIC2(msod_sensor, iqcapture_sink);
 GR_SWIG_BLOCK_MAGIC2(msod_sensor, dummy_capture_trigger);
 %include "msod_sensor/level_capture_trigger.h"
 GR_SWIG_BLOCK_MAGIC2(msod_sensor, level_capture_trigger);
+%include "msod_sensor/subband_capture_trigger.h"
+GR_SWIG_BLOCK_MAGIC2(msod_sensor, subband_capture_trigger);
+%include "msod_sensor/correlation_capture_trigger.h"
+GR_SWIG_BLOCK_MAGIC2(msod_sensor, correlation_capture_trigger);
@@ -252,17 +252,17 @@ class my_top_block(gr.top_block):
 
         self.det_type = options.det_type
         det = 0 if self.det_type == 'avg' else 1
-        self.stats = myblocks.bin_statistics_ff(self.num_ch, meas_frames, det)
 
         # Divide magnitude-square by a constant to obtain power
         # in Watts.  Assumes unit of USRP source is volts.
         impedance = 50.0  # ohms
         Vsq2W_dB = -10.0 * math.log10(self.fft_size * window_power * impedance)
 
-        # Convert from Watts to dBm.
-        W2dBm = blocks.nlog10_ff(10.0, self.num_ch, 30.0 + Vsq2W_dB)
-
-        f2c = blocks.float_to_char(self.num_ch, 1.0)
+        # Convert from Watts to dBm and quantize to int8 in the block
+        # (output format 3).
+        self.stats = myblocks.bin_statistics_ff(self.num_ch, meas_frames, det,
+                                                (), 0.9, 1.0,
+                                                3, 30.0 + Vsq2W_dB, 1.0)
 
         self.dest_host = options.dest_host
 
@@ -274,9 +274,7 @@ class my_top_block(gr.top_block):
             self.connect(self.u, resamp, s2v)
         else:
             self.connect(self.u, s2v)
-        self.connect(s2v, ffter, c2mag, self.aggr, self.stats, W2dBm, f2c,
-                     self.srvr)
-        #self.connect(s2v, ffter, c2mag, self.aggr, self.stats, W2dBm, self.srvr)
+        self.connect(s2v, ffter, c2mag, self.aggr, self.stats, self.srvr)
 
         g = self.u.get_gain_range()
         if options.gain is None:
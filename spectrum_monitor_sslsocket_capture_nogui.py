@@ -23,7 +23,6 @@ from __future__ import print_function
 from gnuradio import gr
 from gnuradio import blocks
 from gnuradio import filter
-from gnuradio import fft
 from gnuradio import uhd
 from gnuradio.eng_option import eng_option
 from optparse import OptionParser
@@ -145,6 +144,30 @@ def parse_options():
                       type="eng_float",
                       default=3.0,
                       help="I/Q capture duration (s), default = [%default]")
+    parser.add_option("",
+                      "--capture-pretrigger",
+                      type="eng_float",
+                      default=0.0,
+                      help="part of the I/Q capture taken from before the " +
+                           "trigger (s), default = [%default]")
+    parser.add_option("",
+                      "--capture-sigmf",
+                      action="store_true",
+                      default=False,
+                      help="store I/Q captures as SigMF recordings")
+    parser.add_option("",
+                      "--capture-metadata",
+                      type="choice",
+                      choices=["mongo", "jsonl", "none"],
+                      default="mongo",
+                      help="where the I/Q capture records go: mongo, " +
+                           "jsonl or none. default = [%default]")
+    parser.add_option("",
+                      "--capture-metadata-file",
+                      type="string",
+                      default="/tmp/capture-records.jsonl",
+                      help="file for --capture-metadata=jsonl. " +
+                           "default = [%default]")
     parser.add_option("",
                       "--power-offset",
                       type="eng_float",
@@ -254,6 +277,10 @@ def init_uhd(options, config):
     u = uhd.usrp_source(device_addr=options.args,
                         stream_args=uhd.stream_args('fc32'))
 
+    # Start the device clock at host time so the rx_time tags that the
+    # capture sink uses to time stamp captures are wall-clock times.
+    u.set_time_now(uhd.time_spec(time.time()))
+
     # Set the subdevice spec
     if options.spec:
         self.u.set_subdev_spec(options.spec, 0)
@@ -394,14 +421,10 @@ class my_top_block(gr.top_block):
 
         # Calibrate dBm (add self.options.power_offset)
         power_cal = blocks.multiply_const_cc(self.options.power_offset)
-        s2v = blocks.stream_to_vector(gr.sizeof_gr_complex, self.fft_size)
 
         mywindow = filter.window.blackmanharris(self.fft_size)
-        ffter = fft.fft_vcc(self.fft_size, True, mywindow, True)
         window_power = sum(map(lambda x: x * x, mywindow))
 
-        c2mag = blocks.complex_to_mag_squared(self.fft_size)
-
         # Calculate bandwidth & center frequency from start/stop values
         self.bandwidth = self.stop_freq - self.start_freq
         self.center_freq = self.start_freq + round(self.bandwidth / 2)
@@ -428,26 +451,25 @@ class my_top_block(gr.top_block):
             wrn += "is greater than sample rate ({} MHz)"
             print(wrn.format(self.bandwidth / 1e6, self.samp_rate / 1e6))
 
-        self.aggr = myblocks.bin_aggregator_ff(self.fft_size, self.num_ch,
-                                               self.bin2ch_map)
-
         meas_frames = max(1, int(round(self.meas_interval * self.samp_rate /
                                        self.fft_size)))  # in fft_frames
         self.meas_duration = meas_frames * self.fft_size / self.samp_rate
         print("Actual measurement duration = {} s".format(self.meas_duration))
 
         det = 0 if self.det_type == "MEAN" else 1
-        self.stats = myblocks.bin_statistics_ff(self.num_ch, meas_frames, det)
 
         # Divide magnitude-square by a constant to obtain power
         # in Watts.  Assumes unit of USRP source is volts.
         impedance = 50.0   # ohms
         Vsq2W_dB = -10.0 * math.log10(self.fft_size * window_power * impedance)
 
-        # Convert from Watts to dBm. 0dBW = 30dBm, so +30
-        W2dBm = blocks.nlog10_ff(10, self.num_ch, Vsq2W_dB + 30)
-
-        f2c = blocks.float_to_char(self.num_ch, 1.0)
+        # Windowed FFT, |X|^2, channel aggregation, detector and the
+        # conversion from Watts to dBm (0dBW = 30dBm, so +30) in one block,
+        # emitting int8 dBm channel vectors.
+        self.aggr = myblocks.channel_power_cb(self.fft_size, mywindow,
+                                              self.num_ch, self.bin2ch_map,
+                                              meas_frames, det,
+                                              Vsq2W_dB + 30)
         if not self.options.source == "file":
             g = self.u.get_gain_range()
             if self.options.gain is None:
@@ -467,6 +489,8 @@ class my_top_block(gr.top_block):
         print("time delta = {}".format(self.delta))
 
         chunksize = int(self.get_sample_rate() * self.options.capture_duration)
+        pretrigger = int(self.get_sample_rate() *
+                         self.options.capture_pretrigger)
         srate = int(self.get_sample_rate())
         event_url = 'https://{}:443/eventstream/postCaptureEvent'
         event_url = event_url.format(self.dest_host)
@@ -476,11 +500,19 @@ class my_top_block(gr.top_block):
                                              capture_dir="/tmp",
                                              mongodb_port=self.mongodb_port,
                                              event_url=event_url,
-                                             time_offset=self.delta)
+                                             time_offset=self.delta,
+                                             pretrigger=pretrigger)
 
         self.initialize_message_headers()
         print(json.dumps(self.event_msg, indent=4))
         capture_sink.set_event_message(str(json.dumps(self.event_msg)))
+        if self.options.capture_sigmf:
+            capture_sink.set_sigmf_output(True)
+            capture_sink.set_center_freq(self.center_freq)
+        backends = {"mongo": 0, "jsonl": 1, "none": 2}
+        capture_sink.set_metadata_backend(
+            backends[self.options.capture_metadata],
+            self.options.capture_metadata_file)
 
         trigger = myblocks.level_capture_trigger(itemsize=gr.sizeof_gr_complex,
                                                  level=-40,
@@ -510,13 +542,13 @@ class my_top_block(gr.top_block):
         self.vsink = blocks.vector_sink_f(1024)
 
         # Connect the blocks together.
-        self.connect(power_cal, s2v, ffter, c2mag, self.aggr, self.stats,
-                     W2dBm, f2c, self.sslsocket_sink)
-        self.flow_graph_1.append([ffter, c2mag, self.stats, W2dBm,
-                                  f2c, self.sslsocket_sink])
+        self.connect(power_cal, self.aggr, self.sslsocket_sink)
+        self.flow_graph_1.append([self.aggr, self.sslsocket_sink])
 
-        # Second pipeline to the sink.
-        self.connect(self.u, trigger, capture_sink)
+        # Second pipeline to the sink. The trigger is a pure sink on its own
+        # branch; the sample offset in its message lines up the capture.
+        self.connect(self.u, trigger)
+        self.connect(self.u, capture_sink)
         # record the configuration.
         self.flow_graph_2 = [trigger, capture_sink]
         self.msg_connect(trigger, "trigger", capture_sink, "capture")